@@ -15,7 +15,8 @@ int main(void) {
   const char* fname = "sample";
   const char* extension = ".log";
 
-  if (!rotator_init(dpath, fname, extension, 1024, 5)) {
+  rotator_t* rotator = rotator_init(dpath, fname, extension, 1024, 5);
+  if (!rotator) {
     fprintf(stderr, "❌ファイルローテーションの初期化に失敗。\n");
     return EXIT_FAILURE;
   }
@@ -29,16 +30,16 @@ int main(void) {
     sleep(1);
     fin_flag += 1;
 
-    if (!rotator_rotate((size_t)len)) {
+    if (!rotator_rotate(rotator, (size_t)len)) {
       fprintf(stderr, "❌ファイルローテーションに失敗。\n");
       return EXIT_FAILURE;
     }
 
-    for (size_t i = 0; i < loop_num; i++) { rotator_fputs(line); }
+    for (size_t i = 0; i < loop_num; i++) { rotator_fputs(rotator, line); }
   }
   free(line);
 
-  rotator_close();
+  rotator_close(&rotator);
 
   return EXIT_SUCCESS;
 }
\ No newline at end of file
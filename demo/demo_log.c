@@ -14,11 +14,28 @@ int main(void) {
     fprintf(stderr, "ログ出力処理の初期化に失敗しました。\n");
     return EXIT_FAILURE;
   }
+  // 異常終了時もキューに残ったログを書き込む
+  logger_install_crash_handler();
 
   LOG_DEBUG("デバッグ値: x=%d,%d,%d,%d", 42, 2, 3, 4);
   LOG_INFO("アプリ開始: pid=%d", 12345);
   LOG_WARN("メモリが少ないかも");
   LOG_ERROR("致命的エラー: %s", "何か悪いことが起きた");
+  // 構造化ログ（JSON Lines形式のシンクではフィールドをメンバとして出力）
+  LOG_INFO_KV("リクエスト完了", "user", "alice", "latency_us", 1234);
+
+  // 監査ログ用に独立したインスタンスを作成（キューとワーカーは別）
+  logger_config_t config = logger_config_default();
+  config.out = LOG_FILE_OUT;
+  config.fpath = "demo_audit.log";
+  logger_t* audit = logger_create(&config);
+  if (!audit) {
+    fprintf(stderr, "監査ログ出力処理の初期化に失敗しました。\n");
+    logger_close();
+    return EXIT_FAILURE;
+  }
+  LOGGER_INFO(audit, "監査: user=%s action=%s", "alice", "login");
+  logger_destroy(&audit);
 
   logger_close();
 
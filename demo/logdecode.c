@@ -0,0 +1,348 @@
+/**
+ * バイナリ形式のログファイルをテキストに変換するツール。
+ *
+ * - 出力形式はデフォルトフォーマット [%T][%l][%F:%L][%f()] - %m と同じ。
+ * - ログを書き込んだ環境と同じバイト順・型サイズの環境で実行すること。
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "logger/argfmt.h"
+#include "logger/logbin.h"
+
+// 呼び出し箇所データ
+typedef struct {
+  bool defined;    // 定義済みフラグ
+  uint64_t level;  // ログレベル
+  uint64_t line;   // 行番号
+  char* fname;     // ファイル名
+  char* func;      // 関数名
+  char* fmt;       // メッセージフォーマット
+  argfmt_t* args;  // コンパイル済みフォーマット
+} site_t;
+
+// デコード状態
+typedef struct {
+  site_t* sites;     // 呼び出し箇所データ配列（IDで参照）
+  size_t nsites;     // 呼び出し箇所データの数
+  uint64_t cur_ns;   // 現在のレコードの時刻[ns]
+  char* data;        // レコードのデータ
+  size_t data_cap;   // レコードのデータのバッファサイズ
+  char* msg;         // メッセージ
+  size_t msg_cap;    // メッセージのバッファサイズ
+} decoder_t;
+
+void usage(int argc, char** argv);
+bool read_varint(FILE* fp, uint64_t* value);
+bool read_bytes(FILE* fp, char** buf, size_t* cap, size_t size);
+char* read_str(FILE* fp);
+bool reserve(char** buf, size_t* cap, size_t size);
+void clear_sites(decoder_t* dec);
+bool read_header(FILE* fp, decoder_t* dec);
+bool read_site(FILE* fp, decoder_t* dec);
+bool read_record(FILE* fp, decoder_t* dec, int tag);
+const char* get_level_name(uint64_t level);
+
+/**
+ * @brief 本プログラムの使い方を出力する。
+ * @param argc コマンドライン引数の数。
+ * @param argv コマンドライン引数のポインタのポインタ。
+ */
+void usage(int argc, char** argv) {
+  (void)argc;
+  fprintf(stderr, "使い方: %s <binary log fpath>\n", argv[0]);
+}
+
+/**
+ * @brief 可変長整数(LEB128形式)を読み込む。
+ * @param fp ファイルストリーム。
+ * @param value 読み込んだ整数。
+ * @return 成功: true, 失敗: false。
+ */
+bool read_varint(FILE* fp, uint64_t* value) {
+  uint64_t v = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    int c = fgetc(fp);
+    if (c == EOF) { return false; }
+    v |= (uint64_t)(c & 0x7f) << shift;
+    if ((c & 0x80) == 0) {
+      *value = v;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/**
+ * @brief バッファを必要なサイズ以上に拡張する。
+ * @param buf バッファ。
+ * @param cap バッファサイズ。
+ * @param size 必要なサイズ。
+ * @return 成功: true, 失敗: false。
+ */
+bool reserve(char** buf, size_t* cap, size_t size) {
+  if (size <= *cap) { return true; }
+
+  char* new_buf = realloc(*buf, size * 2);
+  if (!new_buf) { return false; }
+  *buf = new_buf;
+  *cap = size * 2;
+
+  return true;
+}
+
+/**
+ * @brief 指定バイト数を読み込み、終端文字を付与する。
+ * @param fp ファイルストリーム。
+ * @param buf 読み込み先のバッファ。
+ * @param cap 読み込み先のバッファサイズ。
+ * @param size 読み込むバイト数。
+ * @return 成功: true, 失敗: false。
+ */
+bool read_bytes(FILE* fp, char** buf, size_t* cap, size_t size) {
+  if (!reserve(buf, cap, size + 1)) { return false; }
+  if (size > 0 && fread(*buf, 1, size, fp) != size) { return false; }
+  (*buf)[size] = '\0';
+
+  return true;
+}
+
+/**
+ * @brief バイト数(varint) + 本体の形式の文字列を読み込む。
+ * @param fp ファイルストリーム。
+ * @return 文字列。（失敗: NULL）
+ */
+char* read_str(FILE* fp) {
+  uint64_t len;
+  if (!read_varint(fp, &len)) { return NULL; }
+
+  char* str = NULL;
+  size_t cap = 0;
+  if (!read_bytes(fp, &str, &cap, (size_t)len)) {
+    free(str);
+    return NULL;
+  }
+
+  return str;
+}
+
+/**
+ * @brief 呼び出し箇所データをすべて解放する。
+ * @param dec デコード状態。
+ */
+void clear_sites(decoder_t* dec) {
+  for (size_t i = 0; i < dec->nsites; i++) {
+    site_t* site = &dec->sites[i];
+    free(site->fname);
+    free(site->func);
+    free(site->fmt);
+    argfmt_destroy(&site->args);
+    memset(site, 0, sizeof(*site));
+  }
+}
+
+/**
+ * @brief セクションのヘッダを読み込む。
+ *
+ * - 呼び出し箇所IDはセクションごとに採番されるため、定義をクリアする。
+ * @param fp ファイルストリーム。（マジックナンバーの先頭1バイトは読み込み済み）
+ * @param dec デコード状態。
+ * @return 成功: true, 失敗: false。
+ */
+bool read_header(FILE* fp, decoder_t* dec) {
+  char magic[LOGBIN_MAGIC_LEN];
+  magic[0] = LOGBIN_MAGIC[0];
+  if (fread(magic + 1, 1, LOGBIN_MAGIC_LEN - 1, fp) != LOGBIN_MAGIC_LEN - 1) {
+    return false;
+  }
+  if (memcmp(magic, LOGBIN_MAGIC, LOGBIN_MAGIC_LEN) != 0) {
+    fprintf(stderr, "マジックナンバーが不正です。\n");
+    return false;
+  }
+  if (fgetc(fp) != LOGBIN_VERSION) {
+    fprintf(stderr, "未対応のバージョンです。\n");
+    return false;
+  }
+
+  uint64_t sec;
+  uint64_t nsec;
+  if (!read_varint(fp, &sec) || !read_varint(fp, &nsec)) { return false; }
+  dec->cur_ns = sec * 1000000000u + nsec;
+
+  unsigned char sizes[3];
+  if (fread(sizes, 1, sizeof(sizes), fp) != sizeof(sizes)) { return false; }
+  if (sizes[0] != sizeof(long) || sizes[1] != sizeof(void*) ||
+      sizes[2] != sizeof(long double)) {
+    fprintf(stderr, "書き込み環境と型サイズが異なります。\n");
+    return false;
+  }
+
+  clear_sites(dec);
+
+  return true;
+}
+
+/**
+ * @brief 呼び出し箇所を読み込む。
+ * @param fp ファイルストリーム。
+ * @param dec デコード状態。
+ * @return 成功: true, 失敗: false。
+ */
+bool read_site(FILE* fp, decoder_t* dec) {
+  uint64_t id;
+  uint64_t level;
+  uint64_t line;
+  if (!read_varint(fp, &id) || !read_varint(fp, &level) ||
+      !read_varint(fp, &line)) {
+    return false;
+  }
+
+  // 呼び出し箇所データ配列を拡張
+  if (id >= dec->nsites) {
+    size_t new_n = dec->nsites ? dec->nsites : 64;
+    while (new_n <= id) { new_n *= 2; }
+    site_t* new_sites = realloc(dec->sites, new_n * sizeof(*new_sites));
+    if (!new_sites) { return false; }
+    memset(new_sites + dec->nsites, 0, (new_n - dec->nsites) * sizeof(site_t));
+    dec->sites = new_sites;
+    dec->nsites = new_n;
+  }
+
+  site_t* site = &dec->sites[id];
+  free(site->fname);
+  free(site->func);
+  free(site->fmt);
+  argfmt_destroy(&site->args);
+
+  site->level = level;
+  site->line = line;
+  site->fname = read_str(fp);
+  site->func = read_str(fp);
+  site->fmt = read_str(fp);
+  if (!site->fname || !site->func || !site->fmt) { return false; }
+  site->args = argfmt_compile(site->fmt);
+  site->defined = true;
+
+  return true;
+}
+
+/**
+ * @brief ログレベル名を取得する。
+ * @param level ログレベル。
+ * @return ログレベル名。
+ */
+const char* get_level_name(uint64_t level) {
+  static const char* names[] = {"DEBUG", "INFO", "WARN", "ERROR"};
+  return level < sizeof(names) / sizeof(names[0]) ? names[level] : "UNK";
+}
+
+/**
+ * @brief レコードを読み込み、テキストに変換して標準出力する。
+ * @param fp ファイルストリーム。
+ * @param dec デコード状態。
+ * @param tag レコード種別。
+ * @return 成功: true, 失敗: false。
+ */
+bool read_record(FILE* fp, decoder_t* dec, int tag) {
+  uint64_t id;
+  uint64_t delta;
+  uint64_t size;
+  if (!read_varint(fp, &id) || !read_varint(fp, &delta) ||
+      !read_varint(fp, &size)) {
+    return false;
+  }
+  if (!read_bytes(fp, &dec->data, &dec->data_cap, (size_t)size)) {
+    return false;
+  }
+  dec->cur_ns += delta;
+
+  if (id >= dec->nsites || !dec->sites[id].defined) {
+    fprintf(
+        stderr, "未定義の呼び出し箇所IDです。[%llu]\n", (unsigned long long)id
+    );
+    return false;
+  }
+  site_t* site = &dec->sites[id];
+
+  // メッセージを作成
+  const char* msg = dec->data;
+  if (tag == LOGBIN_TAG_ARGS) {
+    if (!site->args) { return false; }
+    const unsigned char* data = (const unsigned char*)dec->data;
+    int needed =
+        argfmt_render(site->args, data, (size_t)size, dec->msg, dec->msg_cap);
+    if (needed < 0) { return false; }
+    if (!reserve(&dec->msg, &dec->msg_cap, (size_t)needed + 1)) {
+      return false;
+    }
+    argfmt_render(site->args, data, (size_t)size, dec->msg, dec->msg_cap);
+    msg = dec->msg;
+  }
+
+  time_t sec = (time_t)(dec->cur_ns / 1000000000u);
+  struct tm tm = *localtime(&sec);
+  size_t len = strlen(msg);
+  printf(
+      "[%04d-%02d-%02d %02d:%02d:%02d][%-5s][%s:%llu][%s()] - %s%s",
+      tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min,
+      tm.tm_sec, get_level_name(site->level), site->fname,
+      (unsigned long long)site->line, site->func, msg,
+      (len > 0 && msg[len - 1] == '\n') ? "" : "\n"
+  );
+
+  return true;
+}
+
+/**
+ * @brief バイナリログ変換のメイン関数。
+ * @param argc コマンドライン引数の数。
+ * @param argv コマンドライン引数のポインタのポインタ。
+ * @return
+ */
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    usage(argc, argv);
+    return EXIT_FAILURE;
+  }
+
+  FILE* fp = fopen(argv[1], "rb");
+  if (!fp) {
+    fprintf(stderr, "ファイルを開けませんでした。[%s]\n", argv[1]);
+    return EXIT_FAILURE;
+  }
+
+  decoder_t dec = {0};
+  bool res = true;
+  bool has_header = false;
+  int tag;
+  while (res && (tag = fgetc(fp)) != EOF) {
+    if (tag == LOGBIN_MAGIC[0]) {
+      res = read_header(fp, &dec);
+      has_header = res;
+    } else if (!has_header) {
+      fprintf(stderr, "ヘッダがありません。\n");
+      res = false;
+    } else if (tag == LOGBIN_TAG_SITE) {
+      res = read_site(fp, &dec);
+    } else if (tag == LOGBIN_TAG_ARGS || tag == LOGBIN_TAG_MSG) {
+      res = read_record(fp, &dec, tag);
+    } else {
+      fprintf(stderr, "不正なレコード種別です。[0x%02x]\n", tag);
+      res = false;
+    }
+  }
+
+  clear_sites(&dec);
+  free(dec.sites);
+  free(dec.data);
+  free(dec.msg);
+  fclose(fp);
+
+  return res ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,82 @@
+/**
+ * 可変長引数の遅延フォーマットと高速フォーマット用公開ヘッダ。
+ */
+
+#pragma once
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 引数の型
+typedef enum {
+  ARGFMT_NONE = 0,  // 引数なし（リテラルのみ）
+  ARGFMT_INT,       // int (char/short/%cを含む)
+  ARGFMT_UINT,      // unsigned int
+  ARGFMT_LONG,      // long
+  ARGFMT_ULONG,     // unsigned long
+  ARGFMT_LLONG,     // long long
+  ARGFMT_ULLONG,    // unsigned long long
+  ARGFMT_INTMAX,    // intmax_t / uintmax_t
+  ARGFMT_SIZE,      // size_t
+  ARGFMT_PTRDIFF,   // ptrdiff_t
+  ARGFMT_DOUBLE,    // double (floatを含む)
+  ARGFMT_LDOUBLE,   // long double
+  ARGFMT_STR,       // 文字列
+  ARGFMT_PTR,       // ポインタ
+} argfmt_type_t;
+
+// 変換方法
+typedef enum {
+  ARGFMT_CONV_PRINTF = 0,  // snprintf（フラグ、幅、精度等の指定あり）
+  ARGFMT_CONV_DEC,         // %d, %i（長さ修飾子 l, ll, j, z, t を含む）
+  ARGFMT_CONV_UDEC,        // %u（同上）
+  ARGFMT_CONV_HEX,         // %x（同上）
+  ARGFMT_CONV_CHAR,        // %c
+  ARGFMT_CONV_STR,         // %s
+  ARGFMT_CONV_PTR,         // %p
+  ARGFMT_CONV_FIXED,       // %f
+} argfmt_conv_t;
+
+// セグメント（リテラル + 変換指定子1つ）
+typedef struct {
+  char* fmt;           // フォーマット（引数なしの場合、エスケープ解除済み）
+  size_t len;          // フォーマットのバイト数
+  argfmt_type_t type;  // 引数の型
+  argfmt_conv_t conv;  // 変換方法
+  size_t lit_len;      // 変換指定子の前のリテラルのバイト数（snprintf以外）
+} argfmt_seg_t;
+
+// 整数の10進数の最大バイト数（符号を含み、終端文字を含まない）
+#define ARGFMT_DEC_SIZE 20
+
+// コンパイル済みフォーマット
+typedef struct argfmt_t {
+  argfmt_seg_t* segs;  // セグメント配列
+  size_t nseg;         // セグメント数
+  bool deferrable;     // 遅延フォーマット可能フラグ
+} argfmt_t;
+
+argfmt_t* argfmt_compile(const char* fmt);
+void argfmt_destroy(argfmt_t** self);
+size_t argfmt_capture(
+    const argfmt_t* self, va_list ap, unsigned char* out, const size_t cap
+);
+int argfmt_render(
+    const argfmt_t* self, const unsigned char* data, const size_t size,
+    char* out, const size_t cap
+);
+int argfmt_format(
+    const argfmt_t* self, va_list ap, char* out, const size_t cap
+);
+size_t argfmt_put_uint(char* out, unsigned long long value);
+size_t argfmt_put_int(char* out, const long long value);
+void argfmt_put_digits(char* out, unsigned long long value, const size_t width);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,972 @@
+/**
+ * 可変長引数の遅延フォーマット処理関数群。
+ *
+ * - フォーマットを「リテラル + 変換指定子1つ」のセグメントに分割しておき、
+ *   引数は生のバイト列として保存し、後からセグメントごとに文字列化する。
+ * - よく使う変換指定子（フラグ等の指定なし）はsnprintfを使用せずに変換する。
+ */
+
+#include "argfmt_printf.h"
+
+#include "error/error.h"
+
+/**
+ * @brief コンパイル済みフォーマットのメモリを確保する。
+ * @return コンパイル済みフォーマット。
+ */
+static argfmt_t* argfmt_init(void) {
+  argfmt_t* self = calloc(1, sizeof(*self));
+  if (!self) {
+    SET_ERR_LOG_AUTO(ERR_MEM_ALLOC_FAILED);
+    return NULL;
+  }
+
+  self->segs = calloc(INI_SEG_NUM, sizeof(*self->segs));
+  if (!self->segs) {
+    SET_ERR_LOG_AUTO(ERR_MEM_ALLOC_FAILED);
+    free(self);
+    return NULL;
+  }
+  self->deferrable = true;
+
+  return self;
+}
+
+/**
+ * @brief セグメントを末尾に追加する。
+ * @param self コンパイル済みフォーマット。
+ * @param cap セグメント配列の使用可能な数。
+ * @param fmt セグメントの先頭。
+ * @param len セグメントのバイト数。
+ * @param type 引数の型。
+ * @param conv 変換方法。
+ * @return 成功: true, 失敗: false。
+ */
+static bool push_seg(
+    argfmt_t* self, size_t* cap, const char* fmt, const size_t len,
+    const argfmt_type_t type, const argfmt_conv_t conv
+) {
+  if (self->nseg + 1 > *cap) {
+    size_t new_cap = *cap * 2;
+    argfmt_seg_t* new_segs = realloc(self->segs, new_cap * sizeof(*new_segs));
+    if (!new_segs) {
+      SET_ERR_LOG_AUTO(ERR_MEM_ALLOC_FAILED);
+      return false;
+    }
+    self->segs = new_segs;
+    *cap = new_cap;
+  }
+
+  char* str = malloc(len + 1);
+  if (!str) {
+    SET_ERR_LOG_AUTO(ERR_MEM_ALLOC_FAILED);
+    return false;
+  }
+  memcpy(str, fmt, len);
+  str[len] = '\0';
+
+  argfmt_seg_t* seg = &self->segs[self->nseg++];
+  seg->fmt = str;
+  seg->len = len;
+  seg->type = type;
+  seg->conv = conv;
+  // snprintfを使用しない場合、リテラルに%を含まない（変換指定子の位置）
+  if (conv != ARGFMT_CONV_PRINTF) {
+    seg->lit_len = (size_t)(strchr(str, '%') - str);
+  }
+  // リテラルのみのセグメントはそのままコピーできるようにエスケープを解除
+  if (type == ARGFMT_NONE) { seg->len = unescape_literal(str, len); }
+
+  return true;
+}
+
+/**
+ * @brief リテラル中の%%を%に置き換える。
+ * @param str リテラル。
+ * @param len リテラルのバイト数。
+ * @return 置き換え後のバイト数。
+ */
+static size_t unescape_literal(char* str, const size_t len) {
+  size_t out = 0;
+  for (size_t i = 0; i < len; i++) {
+    if (str[i] == '%' && i + 1 < len && str[i + 1] == '%') { i++; }
+    str[out++] = str[i];
+  }
+  str[out] = '\0';
+
+  return out;
+}
+
+/**
+ * @brief 長さ修飾子を解析する。
+ * @param ptr 解析位置。（解析した分だけ進める）
+ * @return 長さ修飾子。
+ */
+static argfmt_len_t parse_length(const char** ptr) {
+  const char* p = *ptr;
+  argfmt_len_t len = ARGFMT_LEN_NONE;
+  switch (*p) {
+    case 'h':
+      len = (p[1] == 'h') ? ARGFMT_LEN_HH : ARGFMT_LEN_H;
+      break;
+    case 'l':
+      len = (p[1] == 'l') ? ARGFMT_LEN_LL : ARGFMT_LEN_L;
+      break;
+    case 'j':
+      len = ARGFMT_LEN_J;
+      break;
+    case 'z':
+      len = ARGFMT_LEN_Z;
+      break;
+    case 't':
+      len = ARGFMT_LEN_T;
+      break;
+    case 'L':
+      len = ARGFMT_LEN_LD;
+      break;
+    default:
+      break;
+  }
+
+  if (len == ARGFMT_LEN_HH || len == ARGFMT_LEN_LL) {
+    p += 2;
+  } else if (len != ARGFMT_LEN_NONE) {
+    p += 1;
+  }
+  *ptr = p;
+
+  return len;
+}
+
+/**
+ * @brief 整数の変換指定子に対応する引数の型を取得する。
+ * @param len 長さ修飾子。
+ * @param sign 符号付きフラグ。
+ * @return 引数の型。
+ */
+static argfmt_type_t get_int_type(const argfmt_len_t len, const bool sign) {
+  switch (len) {
+    case ARGFMT_LEN_L:
+      return sign ? ARGFMT_LONG : ARGFMT_ULONG;
+    case ARGFMT_LEN_LL:
+      return sign ? ARGFMT_LLONG : ARGFMT_ULLONG;
+    case ARGFMT_LEN_J:
+      return ARGFMT_INTMAX;
+    case ARGFMT_LEN_Z:
+      return ARGFMT_SIZE;
+    case ARGFMT_LEN_T:
+      return ARGFMT_PTRDIFF;
+    default:
+      // char/shortはintに昇格して渡される
+      return sign ? ARGFMT_INT : ARGFMT_UINT;
+  }
+}
+
+/**
+ * @brief 変換指定子の変換方法を取得する。
+ *
+ * - フラグ、最小フィールド幅、精度の指定がなく、よく使う変換指定子のみ
+ *   snprintfを使用せずに変換する。
+ * @param ch 変換指定子の文字。
+ * @param len 長さ修飾子。
+ * @param plain フラグ、最小フィールド幅、精度の指定なしフラグ。
+ * @return 変換方法。
+ */
+static argfmt_conv_t get_conv(
+    const char ch, const argfmt_len_t len, const bool plain
+) {
+  if (!plain) { return ARGFMT_CONV_PRINTF; }
+
+  // hh, hは値の切り詰めが必要なため対象外
+  bool int_len = len != ARGFMT_LEN_HH && len != ARGFMT_LEN_H &&
+                 len != ARGFMT_LEN_LD;
+  switch (ch) {
+    case 'd':
+    case 'i':
+      return int_len ? ARGFMT_CONV_DEC : ARGFMT_CONV_PRINTF;
+    case 'u':
+      return int_len ? ARGFMT_CONV_UDEC : ARGFMT_CONV_PRINTF;
+    case 'x':
+      return int_len ? ARGFMT_CONV_HEX : ARGFMT_CONV_PRINTF;
+    case 'c':
+      return len == ARGFMT_LEN_NONE ? ARGFMT_CONV_CHAR : ARGFMT_CONV_PRINTF;
+    case 's':
+      return len == ARGFMT_LEN_NONE ? ARGFMT_CONV_STR : ARGFMT_CONV_PRINTF;
+    case 'p':
+      return len == ARGFMT_LEN_NONE ? ARGFMT_CONV_PTR : ARGFMT_CONV_PRINTF;
+    case 'f':
+      return len == ARGFMT_LEN_NONE ? ARGFMT_CONV_FIXED : ARGFMT_CONV_PRINTF;
+    default:
+      return ARGFMT_CONV_PRINTF;
+  }
+}
+
+/**
+ * @brief 変換指定子を解析する。
+ * @param ptr 変換指定子の先頭。（'%'を指すこと）
+ * @param len 変換指定子のバイト数。
+ * @param type 引数の型。
+ * @param conv 変換方法。
+ * @return 解析結果。
+ */
+static argfmt_spec_t parse_spec(
+    const char* ptr, size_t* len, argfmt_type_t* type, argfmt_conv_t* conv
+) {
+  const char* p = ptr + 1;
+  if (*p == '%') {
+    *len = 2;
+    return ARGFMT_SPEC_ESCAPE;
+  }
+
+  // フラグ
+  while (*p && strchr("-+ #0'", *p)) { p++; }
+  // 最小フィールド幅
+  if (*p == '*') { return ARGFMT_SPEC_UNSUPPORT; }
+  while (isdigit((unsigned char)*p)) { p++; }
+  bool plain = p == ptr + 1;
+  // 精度
+  if (*p == '.') {
+    plain = false;
+    p++;
+    if (*p == '*') { return ARGFMT_SPEC_UNSUPPORT; }
+    while (isdigit((unsigned char)*p)) { p++; }
+  }
+  // 長さ修飾子
+  argfmt_len_t length = parse_length(&p);
+
+  // 変換指定子
+  switch (*p) {
+    case 'd':
+    case 'i':
+      *type = get_int_type(length, true);
+      break;
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+      *type = get_int_type(length, false);
+      break;
+    case 'c':
+      if (length == ARGFMT_LEN_L) { return ARGFMT_SPEC_UNSUPPORT; }
+      *type = ARGFMT_INT;
+      break;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+      *type = (length == ARGFMT_LEN_LD) ? ARGFMT_LDOUBLE : ARGFMT_DOUBLE;
+      break;
+    case 's':
+      if (length == ARGFMT_LEN_L) { return ARGFMT_SPEC_UNSUPPORT; }
+      *type = ARGFMT_STR;
+      break;
+    case 'p':
+      *type = ARGFMT_PTR;
+      break;
+    default:
+      // %n や未知の変換指定子
+      return ARGFMT_SPEC_UNSUPPORT;
+  }
+  *len = (size_t)(p - ptr) + 1;
+  *conv = get_conv(*p, length, plain);
+
+  return ARGFMT_SPEC_ARG;
+}
+
+/**
+ * @brief 出力先に収まる場合のみバイト列を書き込み、書き込み位置を進める。
+ * @param out 出力先。
+ * @param cap 出力先のバイトサイズ。
+ * @param pos 書き込み位置。
+ * @param src 書き込むバイト列。
+ * @param size 書き込むバイト数。
+ */
+static void put_bytes(
+    unsigned char* out, const size_t cap, size_t* pos, const void* src,
+    const size_t size
+) {
+  if (out && *pos + size <= cap) { memcpy(out + *pos, src, size); }
+  *pos += size;
+}
+
+/**
+ * @brief バイト列から値を読み出し、読み出し位置を進める。
+ * @param data バイト列。
+ * @param size バイト列のバイト数。
+ * @param pos 読み出し位置。
+ * @param dst 読み出し先。
+ * @param len 読み出すバイト数。
+ * @return 成功: true, バイト列が不足: false。
+ */
+static bool take_bytes(
+    const unsigned char* data, const size_t size, size_t* pos, void* dst,
+    const size_t len
+) {
+  if (*pos + len > size) { return false; }
+
+  memcpy(dst, data + *pos, len);
+  *pos += len;
+
+  return true;
+}
+
+/**
+ * @brief バイト列から引数の値を読み出し、読み出し位置を進める。
+ * @param seg セグメント。
+ * @param data 引数のバイト列。
+ * @param size 引数のバイト数。
+ * @param pos 読み出し位置。
+ * @param val 引数の値。
+ * @return 成功: true, バイト列が不足: false。
+ */
+static bool take_value(
+    const argfmt_seg_t* seg, const unsigned char* data, const size_t size,
+    size_t* pos, argfmt_val_t* val
+) {
+  switch (seg->type) {
+    case ARGFMT_INT: {
+      int v;
+      if (!take_bytes(data, size, pos, &v, sizeof(v))) { return false; }
+      val->u = (unsigned long long)(long long)v;
+      return true;
+    }
+    case ARGFMT_UINT: {
+      unsigned int v;
+      if (!take_bytes(data, size, pos, &v, sizeof(v))) { return false; }
+      val->u = v;
+      return true;
+    }
+    case ARGFMT_LONG: {
+      long v;
+      if (!take_bytes(data, size, pos, &v, sizeof(v))) { return false; }
+      val->u = (unsigned long long)(long long)v;
+      return true;
+    }
+    case ARGFMT_ULONG: {
+      unsigned long v;
+      if (!take_bytes(data, size, pos, &v, sizeof(v))) { return false; }
+      val->u = v;
+      return true;
+    }
+    case ARGFMT_LLONG: {
+      long long v;
+      if (!take_bytes(data, size, pos, &v, sizeof(v))) { return false; }
+      val->u = (unsigned long long)v;
+      return true;
+    }
+    case ARGFMT_ULLONG: {
+      unsigned long long v;
+      if (!take_bytes(data, size, pos, &v, sizeof(v))) { return false; }
+      val->u = v;
+      return true;
+    }
+    case ARGFMT_INTMAX: {
+      intmax_t v;
+      if (!take_bytes(data, size, pos, &v, sizeof(v))) { return false; }
+      val->u = (unsigned long long)(long long)v;
+      return true;
+    }
+    case ARGFMT_SIZE: {
+      size_t v;
+      if (!take_bytes(data, size, pos, &v, sizeof(v))) { return false; }
+      val->u = v;
+      return true;
+    }
+    case ARGFMT_PTRDIFF: {
+      ptrdiff_t v;
+      if (!take_bytes(data, size, pos, &v, sizeof(v))) { return false; }
+      val->u = (unsigned long long)(long long)v;
+      return true;
+    }
+    case ARGFMT_DOUBLE:
+      return take_bytes(data, size, pos, &val->d, sizeof(val->d));
+    case ARGFMT_LDOUBLE:
+      return take_bytes(data, size, pos, &val->ld, sizeof(val->ld));
+    case ARGFMT_STR: {
+      if (*pos >= size) { return false; }
+      const char* v = (const char*)data + *pos;
+      const char* end = memchr(v, '\0', size - *pos);
+      if (!end) { return false; }
+      *pos += (size_t)(end - v) + 1;
+      val->s = v;
+      return true;
+    }
+    case ARGFMT_PTR:
+      return take_bytes(data, size, pos, &val->p, sizeof(val->p));
+    default:
+      return false;
+  }
+}
+
+/**
+ * @brief 可変長引数から引数の値を取り出す。
+ * @param seg セグメント。
+ * @param ap 可変長引数。
+ * @param val 引数の値。
+ */
+static void arg_value(const argfmt_seg_t* seg, va_list* ap, argfmt_val_t* val) {
+  switch (seg->type) {
+    case ARGFMT_INT:
+      val->u = (unsigned long long)(long long)va_arg(*ap, int);
+      break;
+    case ARGFMT_UINT:
+      val->u = va_arg(*ap, unsigned int);
+      break;
+    case ARGFMT_LONG:
+      val->u = (unsigned long long)(long long)va_arg(*ap, long);
+      break;
+    case ARGFMT_ULONG:
+      val->u = va_arg(*ap, unsigned long);
+      break;
+    case ARGFMT_LLONG:
+      val->u = (unsigned long long)va_arg(*ap, long long);
+      break;
+    case ARGFMT_ULLONG:
+      val->u = va_arg(*ap, unsigned long long);
+      break;
+    case ARGFMT_INTMAX:
+      val->u = (unsigned long long)(long long)va_arg(*ap, intmax_t);
+      break;
+    case ARGFMT_SIZE:
+      val->u = va_arg(*ap, size_t);
+      break;
+    case ARGFMT_PTRDIFF:
+      val->u = (unsigned long long)(long long)va_arg(*ap, ptrdiff_t);
+      break;
+    case ARGFMT_DOUBLE:
+      val->d = va_arg(*ap, double);
+      break;
+    case ARGFMT_LDOUBLE:
+      val->ld = va_arg(*ap, long double);
+      break;
+    case ARGFMT_STR:
+      val->s = va_arg(*ap, const char*);
+      break;
+    case ARGFMT_PTR:
+      val->p = va_arg(*ap, void*);
+      break;
+    default:
+      break;
+  }
+}
+
+/**
+ * @brief 整数を16進数（小文字）で書き込む。
+ * @param out 書き込み先。（16バイト以上必要）
+ * @param value 整数。
+ * @return 書き込んだバイト数。
+ */
+static size_t put_hex(char* out, unsigned long long value) {
+  static const char hex[] = "0123456789abcdef";
+  char digits[16];
+  size_t pos = sizeof(digits);
+  do {
+    digits[--pos] = hex[value & 0xf];
+    value >>= 4;
+  } while (value > 0);
+  memcpy(out, digits + pos, sizeof(digits) - pos);
+
+  return sizeof(digits) - pos;
+}
+
+/**
+ * @brief 浮動小数点数をprintfの%fと同じ形式（小数点以下6桁）で書き込む。
+ *
+ * - 整数で丸めた結果が正確な値の丸めと一致すると判定できる場合のみ
+ *   書き込む。（丸めの境界に近い値、大きな値、無限大、NaNは対象外）
+ * @param out 書き込み先。（ARGFMT_VALUE_SIZE以上のバイト数が必要）
+ * @param value 浮動小数点数。
+ * @return 書き込んだバイト数。（対象外: 0）
+ */
+static size_t put_fixed(char* out, const double value) {
+  if (!isfinite(value)) { return 0; }
+  double abs = value < 0 ? -value : value;
+  if (abs >= FIXED_MAX) { return 0; }
+
+  // 乗算の誤差（1/2 ulp以下）で丸めの方向が変わり得る場合は対象外
+  double scaled = abs * FIXED_SCALE;
+  unsigned long long ipart = (unsigned long long)scaled;
+  double frac = scaled - (double)ipart;
+  double margin = scaled * DBL_EPSILON;
+  if (frac - 0.5 <= margin && 0.5 - frac <= margin) { return 0; }
+  if (frac > 0.5) { ipart++; }
+
+  size_t len = 0;
+  if (signbit(value)) { out[len++] = '-'; }
+  len += argfmt_put_uint(out + len, ipart / (unsigned long long)FIXED_SCALE);
+  out[len++] = '.';
+  argfmt_put_digits(
+      out + len, ipart % (unsigned long long)FIXED_SCALE, FIXED_DIGITS
+  );
+
+  return len + FIXED_DIGITS;
+}
+
+/**
+ * @brief 引数の値を変換方法に応じて書き込む。（文字列以外）
+ * @param out 書き込み先。（ARGFMT_VALUE_SIZE以上のバイト数が必要）
+ * @param seg セグメント。
+ * @param val 引数の値。
+ * @return 書き込んだバイト数。（snprintfで変換する場合: 0）
+ */
+static size_t put_value(
+    char* out, const argfmt_seg_t* seg, const argfmt_val_t* val
+) {
+  switch (seg->conv) {
+    case ARGFMT_CONV_DEC:
+      return argfmt_put_int(out, (long long)val->u);
+    case ARGFMT_CONV_UDEC:
+      return argfmt_put_uint(out, val->u);
+    case ARGFMT_CONV_HEX:
+      return put_hex(out, val->u);
+    case ARGFMT_CONV_CHAR:
+      out[0] = (char)val->u;
+      return 1;
+    case ARGFMT_CONV_PTR:
+      if (!val->p) {
+        memcpy(out, "(nil)", 5);
+        return 5;
+      }
+      memcpy(out, "0x", 2);
+      return 2 + put_hex(out + 2, (unsigned long long)(uintptr_t)val->p);
+    case ARGFMT_CONV_FIXED:
+      return put_fixed(out, val->d);
+    default:
+      return 0;
+  }
+}
+
+/**
+ * @brief 出力先に収まる分だけ文字列を書き込み、書き込み位置を進める。
+ *
+ * - snprintfと同様に、収まらない分も書き込み位置を進める。
+ *   （終端文字の分は残す）
+ * @param out 出力先。（NULL可）
+ * @param cap 出力先のバイトサイズ。
+ * @param len 書き込み位置。
+ * @param src 文字列。
+ * @param size 文字列のバイト数。
+ */
+static void put_text(
+    char* out, const size_t cap, size_t* len, const char* src,
+    const size_t size
+) {
+  if (out && *len + 1 < cap) {
+    size_t room = cap - *len - 1;
+    memcpy(out + *len, src, size < room ? size : room);
+  }
+  *len += size;
+}
+
+/**
+ * @brief セグメントをsnprintfで変換する。
+ * @param seg セグメント。
+ * @param val 引数の値。
+ * @param out 出力先。（NULL可）
+ * @param cap 出力先のバイトサイズ。
+ * @return 必要なバイト数。（失敗: -1）
+ */
+static int print_seg(
+    const argfmt_seg_t* seg, const argfmt_val_t* val, char* out,
+    const size_t cap
+) {
+  switch (seg->type) {
+    case ARGFMT_INT:
+      return snprintf(out, cap, seg->fmt, (int)val->u);
+    case ARGFMT_UINT:
+      return snprintf(out, cap, seg->fmt, (unsigned int)val->u);
+    case ARGFMT_LONG:
+      return snprintf(out, cap, seg->fmt, (long)val->u);
+    case ARGFMT_ULONG:
+      return snprintf(out, cap, seg->fmt, (unsigned long)val->u);
+    case ARGFMT_LLONG:
+      return snprintf(out, cap, seg->fmt, (long long)val->u);
+    case ARGFMT_ULLONG:
+      return snprintf(out, cap, seg->fmt, val->u);
+    case ARGFMT_INTMAX:
+      return snprintf(out, cap, seg->fmt, (intmax_t)val->u);
+    case ARGFMT_SIZE:
+      return snprintf(out, cap, seg->fmt, (size_t)val->u);
+    case ARGFMT_PTRDIFF:
+      return snprintf(out, cap, seg->fmt, (ptrdiff_t)val->u);
+    case ARGFMT_DOUBLE:
+      return snprintf(out, cap, seg->fmt, val->d);
+    case ARGFMT_LDOUBLE:
+      return snprintf(out, cap, seg->fmt, val->ld);
+    case ARGFMT_STR:
+      return snprintf(out, cap, seg->fmt, val->s);
+    case ARGFMT_PTR:
+      return snprintf(out, cap, seg->fmt, val->p);
+    default:
+      return -1;
+  }
+}
+
+/**
+ * @brief 引数ありのセグメントを書き込み、書き込み位置を進める。
+ *
+ * - よく使う変換指定子はsnprintfを使用せず、リテラルと値を直接書き込む。
+ * @param seg セグメント。
+ * @param val 引数の値。
+ * @param out 出力先。（NULL可）
+ * @param cap 出力先のバイトサイズ。
+ * @param len 書き込み位置。
+ * @return 成功: true, 失敗: false。
+ */
+static bool write_seg(
+    const argfmt_seg_t* seg, const argfmt_val_t* val, char* out,
+    const size_t cap, size_t* len
+) {
+  char value[ARGFMT_VALUE_SIZE];
+  const char* str = value;
+  size_t size = 0;
+  if (seg->conv == ARGFMT_CONV_STR) {
+    str = val->s ? val->s : "(null)";
+    size = strlen(str);
+  } else {
+    size = put_value(value, seg, val);
+  }
+
+  if (seg->conv == ARGFMT_CONV_PRINTF || (size == 0 && str == value)) {
+    char* dst = (out && *len < cap) ? out + *len : NULL;
+    size_t room = (out && *len < cap) ? cap - *len : 0;
+    int n = print_seg(seg, val, dst, room);
+    if (n < 0) { return false; }
+    *len += (size_t)n;
+    return true;
+  }
+
+  put_text(out, cap, len, seg->fmt, seg->lit_len);
+  put_text(out, cap, len, str, size);
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// 以降、公開関数
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief printf形式のフォーマットをセグメントに分割する。
+ *
+ * - 遅延フォーマットに対応しない変換指定子を含む場合、
+ *   deferrableをfalseにして返す。（呼び出し元で即時フォーマットする）
+ * @param fmt フォーマット。
+ * @return コンパイル済みフォーマット。
+ */
+argfmt_t* argfmt_compile(const char* fmt) {
+  if (!fmt) {
+    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
+    return NULL;
+  }
+
+  argfmt_t* self = argfmt_init();
+  if (!self) { return NULL; }
+
+  size_t cap = INI_SEG_NUM;
+  const char* start = fmt;
+  const char* ptr = fmt;
+  while (*ptr) {
+    if (*ptr != '%') {
+      ptr++;
+      continue;
+    }
+
+    size_t len = 0;
+    argfmt_type_t type = ARGFMT_NONE;
+    argfmt_conv_t conv = ARGFMT_CONV_PRINTF;
+    argfmt_spec_t spec = parse_spec(ptr, &len, &type, &conv);
+    if (spec == ARGFMT_SPEC_UNSUPPORT) {
+      self->deferrable = false;
+      return self;
+    }
+
+    // リテラルに%%を含む場合、エスケープ解除が必要なためsnprintfで変換
+    if (memchr(start, '%', (size_t)(ptr - start))) {
+      conv = ARGFMT_CONV_PRINTF;
+    }
+    ptr += len;
+    if (spec == ARGFMT_SPEC_ARG) {
+      if (!push_seg(self, &cap, start, (size_t)(ptr - start), type, conv)) {
+        argfmt_destroy(&self);
+        return NULL;
+      }
+      start = ptr;
+    }
+  }
+
+  // 末尾のリテラル
+  if (ptr != start) {
+    if (!push_seg(
+            self, &cap, start, (size_t)(ptr - start), ARGFMT_NONE,
+            ARGFMT_CONV_PRINTF
+        )) {
+      argfmt_destroy(&self);
+      return NULL;
+    }
+  }
+
+  return self;
+}
+
+/**
+ * @brief コンパイル済みフォーマットのメモリを解放する。
+ * @param self コンパイル済みフォーマット。
+ */
+void argfmt_destroy(argfmt_t** self) {
+  if (!self || !*self) { return; }
+
+  if ((*self)->segs) {
+    for (size_t i = 0; i < (*self)->nseg; i++) { free((*self)->segs[i].fmt); }
+    free((*self)->segs);
+  }
+  free(*self);
+  *self = NULL;
+}
+
+/**
+ * @brief 可変長引数を生のバイト列として保存する。
+ *
+ * - 文字列は終端文字を含めてコピーする。（NULLは"(null)"として保存する）
+ * - 出力先に収まらない場合も必要なバイト数を返すため、呼び出し元で
+ *   メモリを確保して再度呼び出すこと。（その際はva_copyした引数を渡す）
+ * @param self コンパイル済みフォーマット。
+ * @param ap 可変長引数。
+ * @param out 出力先。（NULL可）
+ * @param cap 出力先のバイトサイズ。
+ * @return 必要なバイト数。
+ */
+size_t argfmt_capture(
+    const argfmt_t* self, va_list ap, unsigned char* out, const size_t cap
+) {
+  if (!self) { return 0; }
+
+  size_t pos = 0;
+  for (size_t i = 0; i < self->nseg; i++) {
+    switch (self->segs[i].type) {
+      case ARGFMT_INT: {
+        int v = va_arg(ap, int);
+        put_bytes(out, cap, &pos, &v, sizeof(v));
+        break;
+      }
+      case ARGFMT_UINT: {
+        unsigned int v = va_arg(ap, unsigned int);
+        put_bytes(out, cap, &pos, &v, sizeof(v));
+        break;
+      }
+      case ARGFMT_LONG: {
+        long v = va_arg(ap, long);
+        put_bytes(out, cap, &pos, &v, sizeof(v));
+        break;
+      }
+      case ARGFMT_ULONG: {
+        unsigned long v = va_arg(ap, unsigned long);
+        put_bytes(out, cap, &pos, &v, sizeof(v));
+        break;
+      }
+      case ARGFMT_LLONG: {
+        long long v = va_arg(ap, long long);
+        put_bytes(out, cap, &pos, &v, sizeof(v));
+        break;
+      }
+      case ARGFMT_ULLONG: {
+        unsigned long long v = va_arg(ap, unsigned long long);
+        put_bytes(out, cap, &pos, &v, sizeof(v));
+        break;
+      }
+      case ARGFMT_INTMAX: {
+        intmax_t v = va_arg(ap, intmax_t);
+        put_bytes(out, cap, &pos, &v, sizeof(v));
+        break;
+      }
+      case ARGFMT_SIZE: {
+        size_t v = va_arg(ap, size_t);
+        put_bytes(out, cap, &pos, &v, sizeof(v));
+        break;
+      }
+      case ARGFMT_PTRDIFF: {
+        ptrdiff_t v = va_arg(ap, ptrdiff_t);
+        put_bytes(out, cap, &pos, &v, sizeof(v));
+        break;
+      }
+      case ARGFMT_DOUBLE: {
+        double v = va_arg(ap, double);
+        put_bytes(out, cap, &pos, &v, sizeof(v));
+        break;
+      }
+      case ARGFMT_LDOUBLE: {
+        long double v = va_arg(ap, long double);
+        put_bytes(out, cap, &pos, &v, sizeof(v));
+        break;
+      }
+      case ARGFMT_STR: {
+        const char* v = va_arg(ap, const char*);
+        if (!v) { v = "(null)"; }
+        put_bytes(out, cap, &pos, v, strlen(v) + 1);
+        break;
+      }
+      case ARGFMT_PTR: {
+        void* v = va_arg(ap, void*);
+        put_bytes(out, cap, &pos, &v, sizeof(v));
+        break;
+      }
+      default:
+        break;
+    }
+  }
+
+  return pos;
+}
+
+/**
+ * @brief 保存した引数のバイト列からメッセージを作成する。
+ *
+ * - snprintfと同様に、出力先に収まらない場合は切り詰めて終端し、
+ *   必要なバイト数（終端文字を除く）を返す。
+ * @param self コンパイル済みフォーマット。
+ * @param data 引数のバイト列。
+ * @param size 引数のバイト数。
+ * @param out 出力先。（NULL可）
+ * @param cap 出力先のバイトサイズ。
+ * @return 必要なバイト数。（失敗: -1）
+ */
+int argfmt_render(
+    const argfmt_t* self, const unsigned char* data, const size_t size,
+    char* out, const size_t cap
+) {
+  if (!self) {
+    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
+    return -1;
+  }
+
+  size_t len = 0;
+  size_t pos = 0;
+  for (size_t i = 0; i < self->nseg; i++) {
+    const argfmt_seg_t* seg = &self->segs[i];
+    if (seg->type == ARGFMT_NONE) {
+      put_text(out, cap, &len, seg->fmt, seg->len);
+      continue;
+    }
+
+    argfmt_val_t val;
+    if (!take_value(seg, data, size, &pos, &val) ||
+        !write_seg(seg, &val, out, cap, &len)) {
+      return -1;
+    }
+  }
+
+  if (out && cap > 0) { out[len < cap ? len : cap - 1] = '\0'; }
+
+  return (int)len;
+}
+
+/**
+ * @brief 可変長引数からメッセージを作成する。（vsnprintfの代わり）
+ *
+ * - よく使う変換指定子はsnprintfを使用せずに変換する。
+ * - snprintfと同様に、出力先に収まらない場合は切り詰めて終端し、
+ *   必要なバイト数（終端文字を除く）を返す。
+ * - 遅延フォーマットに対応しないフォーマットは変換できないため、
+ *   呼び出し元でvsnprintfを使用すること。
+ * @param self コンパイル済みフォーマット。（deferrableがtrueであること）
+ * @param ap 可変長引数。
+ * @param out 出力先。（NULL可）
+ * @param cap 出力先のバイトサイズ。
+ * @return 必要なバイト数。（失敗: -1）
+ */
+int argfmt_format(
+    const argfmt_t* self, va_list ap, char* out, const size_t cap
+) {
+  if (!self || !self->deferrable) {
+    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
+    return -1;
+  }
+
+  va_list args;
+  va_copy(args, ap);
+  size_t len = 0;
+  for (size_t i = 0; i < self->nseg; i++) {
+    const argfmt_seg_t* seg = &self->segs[i];
+    if (seg->type == ARGFMT_NONE) {
+      put_text(out, cap, &len, seg->fmt, seg->len);
+      continue;
+    }
+
+    argfmt_val_t val;
+    arg_value(seg, &args, &val);
+    if (!write_seg(seg, &val, out, cap, &len)) {
+      va_end(args);
+      return -1;
+    }
+  }
+  va_end(args);
+
+  if (out && cap > 0) { out[len < cap ? len : cap - 1] = '\0'; }
+
+  return (int)len;
+}
+
+/**
+ * @brief 符号なし整数を10進数で書き込む。（2桁ずつ変換）
+ * @param out 書き込み先。（ARGFMT_DEC_SIZE以上のバイト数が必要）
+ * @param value 整数。
+ * @return 書き込んだバイト数。（終端文字は書き込まない）
+ */
+size_t argfmt_put_uint(char* out, unsigned long long value) {
+  char digits[ARGFMT_DEC_SIZE];
+  size_t pos = sizeof(digits);
+  while (value >= 100) {
+    const char* pair = DEC_PAIRS + (value % 100) * 2;
+    value /= 100;
+    digits[--pos] = pair[1];
+    digits[--pos] = pair[0];
+  }
+  if (value >= 10) {
+    const char* pair = DEC_PAIRS + value * 2;
+    digits[--pos] = pair[1];
+    digits[--pos] = pair[0];
+  } else {
+    digits[--pos] = (char)('0' + value);
+  }
+  memcpy(out, digits + pos, sizeof(digits) - pos);
+
+  return sizeof(digits) - pos;
+}
+
+/**
+ * @brief 符号付き整数を10進数で書き込む。
+ * @param out 書き込み先。（ARGFMT_DEC_SIZE以上のバイト数が必要）
+ * @param value 整数。
+ * @return 書き込んだバイト数。（終端文字は書き込まない）
+ */
+size_t argfmt_put_int(char* out, const long long value) {
+  if (value >= 0) { return argfmt_put_uint(out, (unsigned long long)value); }
+
+  out[0] = '-';
+  return 1 + argfmt_put_uint(out + 1, 0ull - (unsigned long long)value);
+}
+
+/**
+ * @brief 整数を0埋めした固定桁数の10進数で書き込む。（2桁ずつ変換）
+ *
+ * - 桁数を超える上位の桁は書き込まない。
+ * @param out 書き込み先。（width以上のバイト数が必要）
+ * @param value 整数。
+ * @param width 桁数。
+ */
+void argfmt_put_digits(
+    char* out, unsigned long long value, const size_t width
+) {
+  size_t pos = width;
+  while (pos >= 2) {
+    const char* pair = DEC_PAIRS + (value % 100) * 2;
+    value /= 100;
+    out[--pos] = pair[1];
+    out[--pos] = pair[0];
+  }
+  if (pos > 0) { out[0] = (char)('0' + value % 10); }
+}
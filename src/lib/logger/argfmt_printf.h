@@ -0,0 +1,118 @@
+/**
+ * 可変長引数の遅延フォーマット用ヘッダ。
+ *
+ * - printf形式のフォーマットを対象とする。
+ */
+
+#pragma once
+
+#include <ctype.h>
+#include <float.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "argfmt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 長さ修飾子
+typedef enum {
+  ARGFMT_LEN_NONE = 0,  // なし
+  ARGFMT_LEN_HH,        // hh
+  ARGFMT_LEN_H,         // h
+  ARGFMT_LEN_L,         // l
+  ARGFMT_LEN_LL,        // ll
+  ARGFMT_LEN_J,         // j
+  ARGFMT_LEN_Z,         // z
+  ARGFMT_LEN_T,         // t
+  ARGFMT_LEN_LD,        // L
+} argfmt_len_t;
+
+// 変換指定子の解析結果
+typedef enum {
+  ARGFMT_SPEC_ARG = 0,   // 引数あり
+  ARGFMT_SPEC_ESCAPE,    // %%
+  ARGFMT_SPEC_UNSUPPORT  // 遅延フォーマット非対応（*, %n, ワイド文字等）
+} argfmt_spec_t;
+
+// 引数の値
+typedef union {
+  unsigned long long u;  // 整数（符号付きの型は符号拡張する）
+  double d;              // double
+  long double ld;        // long double
+  const char* s;         // 文字列
+  void* p;               // ポインタ
+} argfmt_val_t;
+
+// セグメント配列の初期数
+static const size_t INI_SEG_NUM = 8;
+// 変換した値の最大バイト数（文字列を除く）
+#define ARGFMT_VALUE_SIZE 32
+// %fを高速フォーマットする絶対値の上限（以上はsnprintfで変換）
+static const double FIXED_MAX = 1e9;
+// %fの小数点以下の桁数
+static const size_t FIXED_DIGITS = 6;
+// %fの小数点以下の桁数分の倍率
+static const double FIXED_SCALE = 1e6;
+// 2桁ずつ変換するための10進数の表
+static const char DEC_PAIRS[] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static argfmt_t* argfmt_init(void);
+static bool push_seg(
+    argfmt_t* self, size_t* cap, const char* fmt, const size_t len,
+    const argfmt_type_t type, const argfmt_conv_t conv
+);
+static size_t unescape_literal(char* str, const size_t len);
+static argfmt_len_t parse_length(const char** ptr);
+static argfmt_type_t get_int_type(const argfmt_len_t len, const bool sign);
+static argfmt_conv_t get_conv(
+    const char ch, const argfmt_len_t len, const bool plain
+);
+static argfmt_spec_t parse_spec(
+    const char* ptr, size_t* len, argfmt_type_t* type, argfmt_conv_t* conv
+);
+static void put_bytes(
+    unsigned char* out, const size_t cap, size_t* pos, const void* src,
+    const size_t size
+);
+static bool take_bytes(
+    const unsigned char* data, const size_t size, size_t* pos, void* dst,
+    const size_t len
+);
+static bool take_value(
+    const argfmt_seg_t* seg, const unsigned char* data, const size_t size,
+    size_t* pos, argfmt_val_t* val
+);
+static void arg_value(const argfmt_seg_t* seg, va_list* ap, argfmt_val_t* val);
+static size_t put_hex(char* out, unsigned long long value);
+static size_t put_fixed(char* out, const double value);
+static size_t put_value(
+    char* out, const argfmt_seg_t* seg, const argfmt_val_t* val
+);
+static void put_text(
+    char* out, const size_t cap, size_t* len, const char* src,
+    const size_t size
+);
+static int print_seg(
+    const argfmt_seg_t* seg, const argfmt_val_t* val, char* out,
+    const size_t cap
+);
+static bool write_seg(
+    const argfmt_seg_t* seg, const argfmt_val_t* val, char* out,
+    const size_t cap, size_t* len
+);
+
+#ifdef __cplusplus
+}
+#endif
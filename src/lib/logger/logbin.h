@@ -0,0 +1,45 @@
+/**
+ * バイナリログ形式用公開ヘッダ。
+ *
+ * ファイルは以下のセクションの繰り返しで構成する。
+ * （追記モードで開くため、プロセスごとにセクションを追加する）
+ *
+ * - ヘッダ: LOGBIN_MAGIC(7) + LOGBIN_VERSION(1)
+ *           + 基準時刻の秒(varint) + 基準時刻のナノ秒(varint)
+ *           + sizeof(long)(1) + sizeof(void*)(1) + sizeof(long double)(1)
+ * - 呼び出し箇所: 'S' + ID + レベル + 行番号 + ファイル名 + 関数名
+ *                 + メッセージフォーマット
+ * - 引数レコード: 'R' + ID + 時刻差分[ns] + バイト数 + 引数の生のバイト列
+ * - 文字列レコード: 'M' + ID + 時刻差分[ns] + バイト数 + メッセージ
+ *
+ * - 数値はすべてLEB128形式の可変長整数(varint)で、文字列はバイト数(varint)
+ *   + 本体とする。
+ * - 時刻差分は直前のレコード（先頭レコードは基準時刻）との差分とする。
+ * - 引数の生のバイト列は書き込んだ環境のバイト順・型サイズに依存する。
+ * - 呼び出し箇所は、ファイルを開いた時点で登録済みのものをヘッダの直後に、
+ *   以降に登録されたものは最初のレコードの直前に書き込む。
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// セクション先頭のマジックナンバー
+#define LOGBIN_MAGIC "\x7fMYLOGB"
+// マジックナンバーのバイト数
+#define LOGBIN_MAGIC_LEN 7
+// 形式のバージョン
+#define LOGBIN_VERSION 1
+
+// レコード種別
+typedef enum {
+  LOGBIN_TAG_SITE = 'S',  // 呼び出し箇所
+  LOGBIN_TAG_ARGS = 'R',  // 引数レコード（遅延フォーマット）
+  LOGBIN_TAG_MSG = 'M',   // 文字列レコード（フォーマット済み）
+} logbin_tag_t;
+
+#ifdef __cplusplus
+}
+#endif
@@ -4,12 +4,31 @@
 
 #pragma once
 
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// [ユーザが設定変更可能] コンパイル時の最小ログレベル
+//
+// - 0: DEBUG, 1: INFO, 2: WARN, 3: ERROR, 4: すべて無効
+// - 最小ログレベル未満のログ出力用マクロは、引数の評価も含めて削除する。
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL 0
+#endif
+
+// [ユーザが設定変更可能] モジュール名（モジュールごとのログレベル用）
+//
+// - ソースファイルごとに、logger.hのincludeより前に文字列リテラルで定義する。
+// - 定義しない場合、ファイル名でモジュールごとのログレベルを検索する。
+#ifndef LOG_MODULE
+#define LOG_MODULE NULL
+#endif
+
 // ログ出力フラグ
 typedef enum {
   LOG_STD_OUT = 1,  // 標準出力
@@ -25,36 +44,635 @@ typedef enum {
   LOG_LEVEL_ERROR,      // エラー
 } log_level_t;
 
+// 非同期モードのキューが満杯の場合の動作
+typedef enum {
+  LOG_OVERFLOW_DROP_OLDEST = 0,  // 最も古いログを破棄
+  LOG_OVERFLOW_DROP_NEWEST,      // 追加しようとしたログを破棄
+  LOG_OVERFLOW_BLOCK,  // 空きが出るまで待機（タイムアウト時は破棄）
+} log_overflow_t;
+
+// シンク（出力先）の種類
+typedef enum {
+  LOG_SINK_STDOUT = 0,  // 標準出力
+  LOG_SINK_FILE,        // ファイル
+} log_sink_type_t;
+
+// シンク（出力先）の設定
+typedef struct {
+  log_sink_type_t type;  // シンクの種類
+  log_level_t level;     // ログレベル（全体のログレベルより低いものは無効）
+  const char* fmt;       // ログフォーマット（NULLの場合、デフォルト）
+  const char* fpath;     // ファイル: ログファイルパス
+  bool binary;           // ファイル: バイナリ形式フラグ（logbin.h参照）
+  bool json;             // JSON Lines形式フラグ（fmtは使用しない）
+  size_t max_fsize;  // ファイル: ローテーションする最大サイズ（0: 無効）
+  size_t max_fno;    // ファイル: ローテーションで保持するアーカイブ数
+  bool thread;       // 非同期モード: 専用の書き込みスレッドの使用フラグ
+  size_t nqueue;     // 専用スレッド: キューに格納するログの最大数
+  size_t recorder;   // フライトレコーダのバイト数（0: 無効）
+} logger_sink_config_t;
+
+// ログ処理の設定
+//
+// - sinksを指定した場合、out, fmt, fpath, binary, max_fsize, max_fnoは
+//   使用しない。（指定しない場合、これらからシンクを作成する）
+typedef struct {
+  log_out_t out;      // ログ出力フラグ
+  log_level_t level;  // ログレベル
+  const char* fmt;    // ログフォーマット（NULLの場合、デフォルト）
+  bool async;         // 非同期モードフラグ
+  const char* fpath;  // ログファイルパス
+  bool deferred;  // 遅延フォーマットフラグ（非同期モードのみ有効）
+  bool binary;    // ファイル出力のバイナリ形式フラグ（logbin.h参照）
+  bool json;      // JSON Lines形式フラグ（バイナリ形式を優先）
+  bool direct;    // 同期モード: 1行ずつwriteで直接書き込むフラグ
+  size_t nqueue;  // 非同期モード: キューに格納するログの最大数
+  log_overflow_t overflow;  // 非同期モード: キューが満杯の場合の動作
+  unsigned block_ms;  // 非同期モード: 満杯時の待機時間[ms]（0: 1000ms）
+  bool priority;  // 非同期モード: ERRORを破棄しない専用キューで扱うフラグ
+  size_t flush_bytes;  // フラッシュする未フラッシュのバイト数（0: 16KiB）
+  unsigned flush_ms;        // フラッシュ間隔[ms]（0: 無効）
+  log_level_t flush_level;  // 即時フラッシュするログレベル（以上）
+  unsigned coalesce_ms;  // 非同期モード: 重複行をまとめる時間[ms]（0: 無効）
+  unsigned batch_us;     // 非同期モード: 起床をまとめる時間[us]（0: 無効）
+  bool tsc;  // 単調増加時刻（%M）にTSCを使用するフラグ（x86のみ）
+  size_t max_fsize;  // ローテーションする最大ファイルサイズ（0: 無効）
+  size_t max_fno;    // ローテーションで保持するアーカイブ数
+  const logger_sink_config_t* sinks;  // シンクの設定の配列
+  size_t nsink;                       // シンクの設定の数
+} logger_config_t;
+
+struct argfmt_t;
+struct Ini;
+
+// 呼び出し箇所のフィルタ状態（log_site_t.filterの下位ビット）
+typedef enum {
+  LOG_FILTER_NONE = 0,  // 未解決
+  LOG_FILTER_FOLLOW,    // インスタンスのログレベルに従う
+  LOG_FILTER_ON,        // モジュールのログレベルにより有効
+  LOG_FILTER_OFF,       // モジュールのログレベルにより無効
+} log_filter_t;
+
+// フィルタ状態のビットマスク（上位ビットはモジュールごとのログレベルの世代）
+#define LOG_FILTER_MASK 3u
+
+// 呼び出し箇所ごとの出力制限の状態
+//
+// - 出力制限マクロが呼び出し箇所ごとに静的に1つ作成する。
+// - 判定はアトミック操作のみで行い、メッセージのフォーマットより前に抑制する。
+typedef struct {
+  atomic_uint_least64_t count;    // 呼び出し回数（EVERY_N, FIRST_N）
+  atomic_uint_least64_t next_ns;  // 次に出力できる時刻[ns]（EVERY_MS, RATE）
+  atomic_size_t suppressed;       // 前回の出力以降に抑制したログの数
+} log_limit_t;
+
+// 構造化ログのフィールドの型
+typedef enum {
+  LOG_FIELD_INT = 0,  // 符号付き整数
+  LOG_FIELD_UINT,     // 符号なし整数
+  LOG_FIELD_DOUBLE,   // 浮動小数点数
+  LOG_FIELD_BOOL,     // 真偽値
+  LOG_FIELD_STR,      // 文字列（NULLの場合、JSON形式ではnull）
+} log_field_type_t;
+
+// 構造化ログのフィールド
+//
+// - キーは文字列リテラルとし、JSON形式の接頭辞をコンパイル時に作成する。
+//   （キーにはエスケープが必要な文字を含まないこと）
+typedef struct {
+  const char* key;        // キー
+  const char* json_key;   // JSON形式のキーの接頭辞（,"key": の形式）
+  log_field_type_t type;  // 値の型
+  union {
+    long long i;           // 符号付き整数
+    unsigned long long u;  // 符号なし整数
+    double d;              // 浮動小数点数
+    bool b;                // 真偽値
+    const char* s;         // 文字列
+  } value;                 // 値
+} log_field_t;
+
+// ログ処理のインスタンス（logger_posix.h参照）
+typedef struct logger_t logger_t;
+
+// ログ処理のインスタンスの公開部分（logger_tの先頭に配置）
+//
+// - ログ出力用マクロが関数を呼び出さずにログレベルを判定するため公開する。
+typedef struct {
+  atomic_int level;  // 実行時のログレベル（未満のログは呼び出し元で破棄）
+} logger_head_t;
+
+// デフォルトのインスタンス（LOG_*マクロの出力先）
+extern logger_t g_logger;
+// モジュールごとのログレベルの世代（0: 未設定。変更のたびに更新）
+extern atomic_uint g_log_filter_gen;
+
+// ログ呼び出し箇所データ
+//
+// - ログ出力用マクロが呼び出し箇所ごとに静的に1つ作成する。
+// - 初回のログ出力時に登録し、以降はファイル名等を再計算しない。
+typedef struct log_site_t {
+  const char* fpath;        // ファイルパス
+  const char* func;         // 関数名
+  int line;                 // 行番号
+  log_level_t level;        // ログレベル
+  const char* fmt;          // メッセージフォーマット
+  const char* fname;        // ファイル名（登録時に設定）
+  struct argfmt_t* args;    // コンパイル済みフォーマット（登録時に設定）
+  unsigned id;              // 呼び出し箇所ID（登録時に採番）
+  atomic_int state;         // 登録状態
+  struct log_site_t* next;  // 次の登録済み呼び出し箇所
+  const char* module;       // モジュール名（NULLの場合、ファイル名を使用）
+  atomic_uint filter;       // フィルタ状態（世代 | log_filter_t）
+  const char* json;         // JSON形式: 時刻以降の固定部分（登録時に設定）
+} log_site_t;
+
+logger_config_t logger_config_default(void);
+logger_sink_config_t logger_sink_config_default(const log_sink_type_t type);
+bool logger_init_config(const logger_config_t* config);
 bool logger_init(
     const log_out_t out, const log_level_t level, const char* fmt,
     const bool async, const char* fpath
 );
 void logger_close(void);
-void logger_log(
-    const log_level_t level, const char* fpath, const char* func,
-    const int line, const char* fmt, ...
+size_t logger_get_dropped(const log_level_t level);
+bool logger_flush(void);
+void logger_log(log_site_t* site, const char* fmt, ...);
+logger_t* logger_create(const logger_config_t* config);
+void logger_destroy(logger_t** self);
+logger_t* logger_get_default(void);
+size_t logger_get_dropped_from(const logger_t* self, const log_level_t level);
+bool logger_flush_to(logger_t* self);
+void logger_log_to(logger_t* self, log_site_t* site, const char* fmt, ...);
+void logger_set_level(const log_level_t level);
+void logger_set_level_of(logger_t* self, const log_level_t level);
+bool logger_set_module_level(const char* module, const log_level_t level);
+void logger_clear_module_levels(void);
+bool logger_load_levels(struct Ini* ini);
+unsigned logger_resolve_site(log_site_t* site);
+bool logger_limit_every_n(log_limit_t* self, const uint64_t n);
+bool logger_limit_first_n(log_limit_t* self, const uint64_t n);
+bool logger_limit_every_ms(log_limit_t* self, const uint64_t ms);
+bool logger_limit_rate(
+    log_limit_t* self, const uint64_t per_sec, const uint64_t burst
+);
+void logger_log_limited(
+    logger_t* self, log_site_t* site, log_limit_t* limit, const char* fmt, ...
 );
+void logger_log_kv(
+    logger_t* self, log_site_t* site, const log_field_t* fields,
+    const size_t nfield
+);
+bool logger_install_crash_handler(void);
+bool logger_dump_recorder(void);
+bool logger_dump_recorder_to(logger_t* self);
+
+/**
+ * @brief ログレベルが有効か判定する。
+ *
+ * - ログ出力用マクロが引数を評価する前に呼び出す。
+ * - ログレベルはアトミックに読み出すため、logger_set_levelと並行してよい。
+ * @param self ログ処理のインスタンス。
+ * @param level ログレベル。
+ * @return 有効: true, 無効: false。
+ */
+static inline bool logger_is_enabled(
+    const logger_t* self, const log_level_t level
+) {
+  const logger_head_t* head = (const logger_head_t*)(const void*)self;
+  if (!head) { return false; }
+
+  return (int)level >= atomic_load_explicit(&head->level, memory_order_relaxed);
+}
+
+/**
+ * @brief 呼び出し箇所のログが有効か判定する。
+ *
+ * - モジュールごとのログレベルが未設定の場合、インスタンスのログレベルのみ
+ *   判定する。
+ * - 設定済みの場合、呼び出し箇所にキャッシュしたフィルタ状態で判定する。
+ *   （世代が変わった場合のみ、logger_resolve_siteで再解決する）
+ * @param self ログ処理のインスタンス。
+ * @param site 呼び出し箇所データ。
+ * @param level 呼び出し箇所のログレベル。
+ * @return 有効: true, 無効: false。
+ */
+static inline bool logger_site_enabled(
+    const logger_t* self, log_site_t* site, const log_level_t level
+) {
+  unsigned gen = atomic_load_explicit(&g_log_filter_gen, memory_order_relaxed);
+  if (gen == 0) { return logger_is_enabled(self, level); }
+
+  unsigned filter = atomic_load_explicit(&site->filter, memory_order_relaxed);
+  if ((filter & ~LOG_FILTER_MASK) != gen) {
+    filter = logger_resolve_site(site);
+  }
+  switch ((log_filter_t)(filter & LOG_FILTER_MASK)) {
+    case LOG_FILTER_ON:
+      return true;
+    case LOG_FILTER_OFF:
+      return false;
+    default:
+      return logger_is_enabled(self, level);
+  }
+}
 
+/**
+ * @brief 可変長引数の先頭（メッセージフォーマット）を取得する補助マクロ。
+ */
+#define LOG_FMT_(fmt, ...) fmt
+
+/**
+ * @brief 呼び出し箇所データを静的に定義する補助マクロ。
+ *
+ * - メッセージフォーマットは文字列リテラルであること。
+ */
+#define LOG_SITE_DEFINE_(lv, ...)      \
+  static log_site_t log_site_ = {      \
+      .fpath = __FILE__,               \
+      .func = __func__,                \
+      .line = __LINE__,                \
+      .level = (lv),                   \
+      .fmt = LOG_FMT_(__VA_ARGS__, 0), \
+      .module = LOG_MODULE,            \
+  }
+
+/**
+ * @brief 呼び出し箇所データを静的に作成してログを出力する補助マクロ。
+ *
+ * - ログレベルが無効な場合、引数を評価しない。
+ */
+#define LOG_SITE_(lv, ...)                                  \
+  do {                                                      \
+    LOG_SITE_DEFINE_(lv, __VA_ARGS__);                      \
+    if (logger_site_enabled(&g_logger, &log_site_, (lv))) { \
+      logger_log(&log_site_, __VA_ARGS__);                  \
+    }                                                       \
+  } while (0)
+
+/**
+ * @brief 呼び出し箇所データを静的に作成して指定したインスタンスにログを
+ *        出力する補助マクロ。
+ *
+ * - ログレベルが無効な場合、引数を評価しない。
+ */
+#define LOG_SITE_TO_(lg, lv, ...)                             \
+  do {                                                        \
+    logger_t* log_logger_ = (lg);                             \
+    LOG_SITE_DEFINE_(lv, __VA_ARGS__);                        \
+    if (logger_site_enabled(log_logger_, &log_site_, (lv))) { \
+      logger_log_to(log_logger_, &log_site_, __VA_ARGS__);    \
+    }                                                         \
+  } while (0)
+
+/**
+ * @brief コンパイル時に無効化したログ出力用マクロ。
+ *
+ * - 呼び出しを削除し、引数も評価しない。（未使用変数の警告を避けるため、
+ *   到達しない分岐で参照する）
+ */
+#define LOG_DISABLED_(...)                    \
+  do {                                        \
+    if (0) { logger_log(NULL, __VA_ARGS__); } \
+  } while (0)
+
+/**
+ * @brief コンパイル時に無効化したインスタンス指定のログ出力用マクロ。
+ */
+#define LOG_DISABLED_TO_(lg, ...)                      \
+  do {                                                 \
+    if (0) { logger_log_to((lg), NULL, __VA_ARGS__); } \
+  } while (0)
+
+#if LOG_COMPILE_LEVEL <= 0
 /**
  * @brief ログ出力用マクロ。（デバッグ）
  */
-#define LOG_DEBUG(...) \
-  logger_log(LOG_LEVEL_DEBUG, __FILE__, __func__, __LINE__, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_SITE_(LOG_LEVEL_DEBUG, __VA_ARGS__)
+/**
+ * @brief インスタンス指定のログ出力用マクロ。（デバッグ）
+ */
+#define LOGGER_DEBUG(lg, ...) LOG_SITE_TO_(lg, LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) LOG_DISABLED_(__VA_ARGS__)
+#define LOGGER_DEBUG(lg, ...) LOG_DISABLED_TO_(lg, __VA_ARGS__)
+#endif
+
+#if LOG_COMPILE_LEVEL <= 1
 /**
  * @brief ログ出力用マクロ。（情報）
  */
-#define LOG_INFO(...) \
-  logger_log(LOG_LEVEL_INFO, __FILE__, __func__, __LINE__, __VA_ARGS__)
+#define LOG_INFO(...) LOG_SITE_(LOG_LEVEL_INFO, __VA_ARGS__)
+/**
+ * @brief インスタンス指定のログ出力用マクロ。（情報）
+ */
+#define LOGGER_INFO(lg, ...) LOG_SITE_TO_(lg, LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...) LOG_DISABLED_(__VA_ARGS__)
+#define LOGGER_INFO(lg, ...) LOG_DISABLED_TO_(lg, __VA_ARGS__)
+#endif
+
+#if LOG_COMPILE_LEVEL <= 2
 /**
  * @brief ログ出力用マクロ。（警告）
  */
-#define LOG_WARN(...) \
-  logger_log(LOG_LEVEL_WARN, __FILE__, __func__, __LINE__, __VA_ARGS__)
+#define LOG_WARN(...) LOG_SITE_(LOG_LEVEL_WARN, __VA_ARGS__)
+/**
+ * @brief インスタンス指定のログ出力用マクロ。（警告）
+ */
+#define LOGGER_WARN(lg, ...) LOG_SITE_TO_(lg, LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define LOG_WARN(...) LOG_DISABLED_(__VA_ARGS__)
+#define LOGGER_WARN(lg, ...) LOG_DISABLED_TO_(lg, __VA_ARGS__)
+#endif
+
+#if LOG_COMPILE_LEVEL <= 3
 /**
  * @brief ログ出力用マクロ。（エラー）
  */
-#define LOG_ERROR(...) \
-  logger_log(LOG_LEVEL_ERROR, __FILE__, __func__, __LINE__, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_SITE_(LOG_LEVEL_ERROR, __VA_ARGS__)
+/**
+ * @brief インスタンス指定のログ出力用マクロ。（エラー）
+ */
+#define LOGGER_ERROR(lg, ...) LOG_SITE_TO_(lg, LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) LOG_DISABLED_(__VA_ARGS__)
+#define LOGGER_ERROR(lg, ...) LOG_DISABLED_TO_(lg, __VA_ARGS__)
+#endif
+
+/**
+ * @brief 出力制限付きでログを出力する補助マクロ。
+ *
+ * - ログレベルが有効な場合のみ出力制限を判定し、抑制した場合は引数を
+ *   評価しない。
+ * - passは出力制限の状態log_limit_を参照する判定式とする。
+ * - コンパイル時の最小ログレベル未満のログレベルを定数で指定した場合、
+ *   呼び出しごと削除される。
+ */
+#define LOG_LIMIT_TO_(lg, lv, pass, ...)                                       \
+  do {                                                                         \
+    if ((int)(lv) >= LOG_COMPILE_LEVEL) {                                      \
+      logger_t* log_logger_ = (lg);                                            \
+      static log_limit_t log_limit_;                                           \
+      LOG_SITE_DEFINE_(lv, __VA_ARGS__);                                       \
+      if (logger_site_enabled(log_logger_, &log_site_, (lv)) && (pass)) {      \
+        logger_log_limited(log_logger_, &log_site_, &log_limit_, __VA_ARGS__); \
+      }                                                                        \
+    }                                                                          \
+  } while (0)
+
+/**
+ * @brief インスタンス指定の出力制限付きログ出力用マクロ。（N回に1回）
+ */
+#define LOGGER_EVERY_N(lg, lv, n, ...) \
+  LOG_LIMIT_TO_(lg, lv, logger_limit_every_n(&log_limit_, (n)), __VA_ARGS__)
+/**
+ * @brief インスタンス指定の出力制限付きログ出力用マクロ。（最初のN回）
+ */
+#define LOGGER_FIRST_N(lg, lv, n, ...) \
+  LOG_LIMIT_TO_(lg, lv, logger_limit_first_n(&log_limit_, (n)), __VA_ARGS__)
+/**
+ * @brief インスタンス指定の出力制限付きログ出力用マクロ。（ms間隔で1回）
+ */
+#define LOGGER_EVERY_MS(lg, lv, ms, ...) \
+  LOG_LIMIT_TO_(lg, lv, logger_limit_every_ms(&log_limit_, (ms)), __VA_ARGS__)
+/**
+ * @brief インスタンス指定の出力制限付きログ出力用マクロ。（トークンバケット）
+ */
+#define LOGGER_RATELIMITED(lg, lv, per_sec, burst, ...)           \
+  LOG_LIMIT_TO_(                                                  \
+      lg, lv, logger_limit_rate(&log_limit_, (per_sec), (burst)), \
+      __VA_ARGS__                                                 \
+  )
+
+/**
+ * @brief 出力制限付きログ出力用マクロ。（N回に1回）
+ *
+ * - 例: LOG_EVERY_N(LOG_LEVEL_ERROR, 100, "failed: %d", err);
+ */
+#define LOG_EVERY_N(lv, n, ...) LOGGER_EVERY_N(&g_logger, lv, n, __VA_ARGS__)
+/**
+ * @brief 出力制限付きログ出力用マクロ。（最初のN回）
+ */
+#define LOG_FIRST_N(lv, n, ...) LOGGER_FIRST_N(&g_logger, lv, n, __VA_ARGS__)
+/**
+ * @brief 出力制限付きログ出力用マクロ。（ms間隔で1回）
+ */
+#define LOG_EVERY_MS(lv, ms, ...) \
+  LOGGER_EVERY_MS(&g_logger, lv, ms, __VA_ARGS__)
+/**
+ * @brief 出力制限付きログ出力用マクロ。（トークンバケット）
+ *
+ * - 1秒あたりper_sec回、最大burst回まで連続で出力する。
+ */
+#define LOG_RATELIMITED(lv, per_sec, burst, ...) \
+  LOGGER_RATELIMITED(&g_logger, lv, per_sec, burst, __VA_ARGS__)
+
+/**
+ * @brief 構造化ログのフィールドを作成する。（符号付き整数）
+ * @param key キー。
+ * @param json_key JSON形式のキーの接頭辞。
+ * @param value 値。
+ * @return フィールド。
+ */
+static inline log_field_t log_field_int(
+    const char* key, const char* json_key, const long long value
+) {
+  log_field_t field = {.key = key, .json_key = json_key};
+  field.type = LOG_FIELD_INT;
+  field.value.i = value;
+  return field;
+}
+
+/**
+ * @brief 構造化ログのフィールドを作成する。（符号なし整数）
+ * @param key キー。
+ * @param json_key JSON形式のキーの接頭辞。
+ * @param value 値。
+ * @return フィールド。
+ */
+static inline log_field_t log_field_uint(
+    const char* key, const char* json_key, const unsigned long long value
+) {
+  log_field_t field = {.key = key, .json_key = json_key};
+  field.type = LOG_FIELD_UINT;
+  field.value.u = value;
+  return field;
+}
+
+/**
+ * @brief 構造化ログのフィールドを作成する。（浮動小数点数）
+ * @param key キー。
+ * @param json_key JSON形式のキーの接頭辞。
+ * @param value 値。
+ * @return フィールド。
+ */
+static inline log_field_t log_field_double(
+    const char* key, const char* json_key, const double value
+) {
+  log_field_t field = {.key = key, .json_key = json_key};
+  field.type = LOG_FIELD_DOUBLE;
+  field.value.d = value;
+  return field;
+}
+
+/**
+ * @brief 構造化ログのフィールドを作成する。（真偽値）
+ * @param key キー。
+ * @param json_key JSON形式のキーの接頭辞。
+ * @param value 値。
+ * @return フィールド。
+ */
+static inline log_field_t log_field_bool(
+    const char* key, const char* json_key, const bool value
+) {
+  log_field_t field = {.key = key, .json_key = json_key};
+  field.type = LOG_FIELD_BOOL;
+  field.value.b = value;
+  return field;
+}
+
+/**
+ * @brief 構造化ログのフィールドを作成する。（文字列）
+ * @param key キー。
+ * @param json_key JSON形式のキーの接頭辞。
+ * @param value 値。（ログ出力時にコピーする）
+ * @return フィールド。
+ */
+static inline log_field_t log_field_str(
+    const char* key, const char* json_key, const char* value
+) {
+  log_field_t field = {.key = key, .json_key = json_key};
+  field.type = LOG_FIELD_STR;
+  field.value.s = value;
+  return field;
+}
+
+/**
+ * @brief 値の型に応じて構造化ログのフィールドを作成する補助マクロ。
+ *
+ * - キーは文字列リテラルであること。
+ * - 対応しない型の値を指定した場合、コンパイルエラーとする。
+ */
+#define LOG_FIELD_(key, v)                \
+  _Generic(                               \
+      (v),                                \
+      _Bool: log_field_bool,              \
+      char: log_field_int,                \
+      signed char: log_field_int,         \
+      short: log_field_int,               \
+      int: log_field_int,                 \
+      long: log_field_int,                \
+      long long: log_field_int,           \
+      unsigned char: log_field_uint,      \
+      unsigned short: log_field_uint,     \
+      unsigned int: log_field_uint,       \
+      unsigned long: log_field_uint,      \
+      unsigned long long: log_field_uint, \
+      float: log_field_double,            \
+      double: log_field_double,           \
+      char*: log_field_str,               \
+      const char*: log_field_str          \
+  )(key, ",\"" key "\":", (v))
+
+/**
+ * @brief キーと値の組の数（引数の数）を取得する補助マクロ。（最大8組）
+ */
+#define LOG_KV_NARG_(...)                                                   \
+  LOG_KV_NARG2_(                                                            \
+      __VA_ARGS__, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0 \
+  )
+#define LOG_KV_NARG2_(                                                     \
+    a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, \
+    n, ...                                                                 \
+)                                                                          \
+  n
+#define LOG_KV_CAT_(a, b) LOG_KV_CAT2_(a, b)
+#define LOG_KV_CAT2_(a, b) a##b
+
+/**
+ * @brief キーと値の組をフィールドの初期化子に展開する補助マクロ。
+ */
+#define LOG_KV_FIELDS_(...) \
+  LOG_KV_CAT_(LOG_KV_FIELDS_, LOG_KV_NARG_(__VA_ARGS__))(__VA_ARGS__)
+#define LOG_KV_FIELDS_2(k, v) LOG_FIELD_(k, v)
+#define LOG_KV_FIELDS_4(k, v, ...) \
+  LOG_FIELD_(k, v), LOG_KV_FIELDS_2(__VA_ARGS__)
+#define LOG_KV_FIELDS_6(k, v, ...) \
+  LOG_FIELD_(k, v), LOG_KV_FIELDS_4(__VA_ARGS__)
+#define LOG_KV_FIELDS_8(k, v, ...) \
+  LOG_FIELD_(k, v), LOG_KV_FIELDS_6(__VA_ARGS__)
+#define LOG_KV_FIELDS_10(k, v, ...) \
+  LOG_FIELD_(k, v), LOG_KV_FIELDS_8(__VA_ARGS__)
+#define LOG_KV_FIELDS_12(k, v, ...) \
+  LOG_FIELD_(k, v), LOG_KV_FIELDS_10(__VA_ARGS__)
+#define LOG_KV_FIELDS_14(k, v, ...) \
+  LOG_FIELD_(k, v), LOG_KV_FIELDS_12(__VA_ARGS__)
+#define LOG_KV_FIELDS_16(k, v, ...) \
+  LOG_FIELD_(k, v), LOG_KV_FIELDS_14(__VA_ARGS__)
+
+// 引数の数が奇数の場合、存在しないメンバを指定してコンパイルエラーとする
+#define LOG_KV_ODD_(...) .log_kv_requires_key_value_pairs = 0
+#define LOG_KV_FIELDS_1 LOG_KV_ODD_
+#define LOG_KV_FIELDS_3 LOG_KV_ODD_
+#define LOG_KV_FIELDS_5 LOG_KV_ODD_
+#define LOG_KV_FIELDS_7 LOG_KV_ODD_
+#define LOG_KV_FIELDS_9 LOG_KV_ODD_
+#define LOG_KV_FIELDS_11 LOG_KV_ODD_
+#define LOG_KV_FIELDS_13 LOG_KV_ODD_
+#define LOG_KV_FIELDS_15 LOG_KV_ODD_
+
+/**
+ * @brief 構造化ログを出力する補助マクロ。
+ *
+ * - メッセージは文字列リテラルとし、フォーマットしない。
+ * - ログレベルが無効な場合、値を評価しない。
+ * - コンパイル時の最小ログレベル未満のログレベルを定数で指定した場合、
+ *   呼び出しごと削除される。
+ */
+#define LOG_KV_TO_(lg, lv, msg, ...)                                     \
+  do {                                                                   \
+    if ((int)(lv) >= LOG_COMPILE_LEVEL) {                                \
+      logger_t* log_logger_ = (lg);                                      \
+      LOG_SITE_DEFINE_(lv, msg);                                         \
+      if (logger_site_enabled(log_logger_, &log_site_, (lv))) {          \
+        const log_field_t log_fields_[] = {LOG_KV_FIELDS_(__VA_ARGS__)}; \
+        logger_log_kv(                                                   \
+            log_logger_, &log_site_, log_fields_,                        \
+            sizeof(log_fields_) / sizeof(log_fields_[0])                 \
+        );                                                               \
+      }                                                                  \
+    }                                                                    \
+  } while (0)
+
+/**
+ * @brief インスタンス指定の構造化ログ出力用マクロ。
+ *
+ * - 例: LOGGER_KV(lg, LOG_LEVEL_INFO, "login", "user", id, "ok", true);
+ */
+#define LOGGER_KV(lg, lv, msg, ...) LOG_KV_TO_(lg, lv, msg, __VA_ARGS__)
+/**
+ * @brief 構造化ログ出力用マクロ。（デバッグ）
+ */
+#define LOG_DEBUG_KV(msg, ...) \
+  LOG_KV_TO_(&g_logger, LOG_LEVEL_DEBUG, msg, __VA_ARGS__)
+/**
+ * @brief 構造化ログ出力用マクロ。（情報）
+ *
+ * - 例: LOG_INFO_KV("request done", "user", id, "latency_us", t);
+ */
+#define LOG_INFO_KV(msg, ...) \
+  LOG_KV_TO_(&g_logger, LOG_LEVEL_INFO, msg, __VA_ARGS__)
+/**
+ * @brief 構造化ログ出力用マクロ。（警告）
+ */
+#define LOG_WARN_KV(msg, ...) \
+  LOG_KV_TO_(&g_logger, LOG_LEVEL_WARN, msg, __VA_ARGS__)
+/**
+ * @brief 構造化ログ出力用マクロ。（エラー）
+ */
+#define LOG_ERROR_KV(msg, ...) \
+  LOG_KV_TO_(&g_logger, LOG_LEVEL_ERROR, msg, __VA_ARGS__)
 
 #ifdef __cplusplus
 }
@@ -7,14 +7,24 @@
 #include "logger_posix.h"
 
 #include "error/error.h"
+#include "ini/ini.h"
 #include "utils.h"
 
 /**
- * @brief ログデータのメモリを確保する。
- * @return ログデータ。
+ * @brief ログデータ配列のメモリを確保する。
+ * @param nitem ログデータの数。
+ * @return ログデータ配列。
  */
-static log_item_t* log_item_init(void) {
-  log_item_t* self = (log_item_t*)calloc(1, sizeof(*self));
+static log_item_t* items_init(const size_t nitem) {
+  if (nitem < 1) {
+    SET_ERR_LOG(
+        ERR_INVALID_ARG,
+        "The number of log items must be set to 1 or more. [%zu]", nitem
+    );
+    return NULL;
+  }
+
+  log_item_t* self = (log_item_t*)calloc(nitem, sizeof(*self));
   if (!self) {
     SET_ERR_LOG_AUTO(ERR_MEM_ALLOC_FAILED);
     return NULL;
@@ -24,691 +34,4773 @@ static log_item_t* log_item_init(void) {
 }
 
 /**
- * @brief ログデータのメモリを解放する。
- * @param self ログデータ。
+ * @brief ログデータ配列のメモリを解放する。
+ * @param self ログデータ配列。
+ * @param nitem ログデータの数。
  */
-static void log_item_destroy(log_item_t** self) {
+static void items_destroy(log_item_t** self, const size_t nitem) {
   if (!self || !*self) { return; }
 
-  if ((*self)->fname) { free((*self)->fname); }
-  if ((*self)->func) { free((*self)->func); }
-  if ((*self)->msg) { free((*self)->msg); }
+  for (size_t i = 0; i < nitem; i++) { item_clear(&(*self)[i]); }
   free(*self);
   *self = NULL;
 }
 
 /**
- * @brief ログフォーマットのメモリを確保する。
- * @param fmt ログフォーマット。
- * @return ログフォーマット。
+ * @brief 未使用のログデータを格納するプールを作成する。
+ * @param items ログデータ配列。
+ * @param nitem ログデータの数。
+ * @return プール。
  */
-static char* format_init(const char* fmt) {
-  if (!fmt) {
+static ring_t* pool_init(log_item_t* items, const size_t nitem) {
+  if (!items) {
     SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
     return NULL;
   }
 
-  char* self = my_strdup(fmt);
+  ring_t* self = ring_init(nitem);
   if (!self) { return NULL; }
 
+  for (size_t i = 0; i < nitem; i++) { ring_push(self, &items[i]); }
+
   return self;
 }
 
 /**
- * @brief ログフォーマットのメモリを解放する。
- * @param self ログフォーマット。
+ * @brief ログデータのメッセージをクリアする。
+ *
+ * - インライン領域に収まらなかったメッセージのメモリを解放する。
+ * @param self ログデータ。
  */
-static void format_destroy(char** self) {
-  if (!self || !*self) { return; }
+static void item_clear(log_item_t* self) {
+  if (!self) { return; }
 
-  free(*self);
-  *self = NULL;
+  if (self->ovf) { free(self->ovf); }
+  self->ovf = NULL;
+  self->msg = self->buf;
+  self->deferred = false;
+  self->len = 0;
+  self->kv_len = 0;
+  self->buf[0] = '\0';
 }
 
 /**
- * @brief ファイルを開く。
- * @param fpath ファイルパス。
- * @return ファイルストリーム。
+ * @brief ログデータのインライン領域に収まらない本体の格納先を確保する。
+ *
+ * - 同期モードでは出力後に不要となるため、スレッドごとの作業バッファを
+ *   再利用する。（内容は保持しない）
+ * - 非同期モードではキューに残るため、メモリを確保する。
+ * @param self ログデータ。
+ * @param size 格納するバイト数。
+ * @return 成功: 格納先, 失敗: NULL。
  */
-static FILE* fp_init(const char* fpath) {
-  if (!fpath) {
-    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
-    return NULL;
+static char* item_reserve(log_item_t* self, const size_t size) {
+  if (!self->lane) {
+    log_buf_t* scratch = &get_tls()->scratch;
+    scratch->len = 0;
+    return buf_reserve(scratch, size) ? scratch->data : NULL;
   }
 
-  FILE* self = fopen(fpath, "a");
-  if (!self) {
-    SET_ERR_LOG_AUTO(ERR_FILE_OPEN_FAILED);
-    return NULL;
-  }
+  self->ovf = (char*)malloc(size);
+  if (!self->ovf) { SET_ERR_LOG_AUTO(ERR_MEM_ALLOC_FAILED); }
 
-  return self;
+  return self->ovf;
 }
 
 /**
- * @brief ファイルをフラッシュして閉じる。
- * @param self ファイルストリーム。
+ * @brief ログデータのメッセージをフォーマットする。
+ *
+ * - 呼び出し箇所のコンパイル済みフォーマットを使用できる場合、よく使う
+ *   変換指定子をvsnprintfを使用せずに変換する。
+ * @param self ログデータ。
+ * @param fmt 可変長メッセージ。
+ * @param out 出力先。
+ * @param cap 出力先のバイトサイズ。
+ * @param ap 可変長引数。
+ * @return 必要なバイト数。（失敗: 負の値）
  */
-static void fp_destroy(FILE** self) {
-  if (!self || !*self) { return; }
+static int item_format(
+    const log_item_t* self, const char* fmt, char* out, const size_t cap,
+    va_list ap
+) {
+  const argfmt_t* args = self->site ? self->site->args : NULL;
+  if (args && args->deferrable && fmt == self->site->fmt) {
+    return argfmt_format(args, ap, out, cap);
+  }
 
-  fflush(*self);
-  fclose(*self);
-  *self = NULL;
+  return vsnprintf(out, cap, fmt, ap);
 }
 
 /**
- * @brief ファイルのバッファリング方式を設定する。
- * @param self ファイルストリーム。
- * @param bufsize バッファサイズ。
+ * @brief ログデータにメッセージを設定する。
+ *
+ * - 同期モードではスレッドごとの作業バッファに直接フォーマットする。
+ *   （バッファは拡張したまま再利用するため、通常は1回のフォーマットで済む）
+ * - 非同期モードではまずインライン領域にフォーマットし、収まらない場合のみ
+ *   メモリを確保する。
+ * - 格納先を確保できない場合、切り詰めたメッセージを残す。
+ * @param self ログデータ。
+ * @param fmt 可変長メッセージ。
+ * @param ap 可変長引数。
  * @return 成功: true, 失敗: false。
  */
-static bool fp_setvbuf(FILE* self, const size_t bufsize) {
-  if (!self) {
+static bool item_set_msg(log_item_t* self, const char* fmt, va_list ap) {
+  if (!self || !fmt) {
     SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
     return false;
   }
 
-  if (setvbuf(self, NULL, _IOFBF, bufsize) != 0) {
-    SET_ERR_LOG_AUTO(ERR_IO_ERROR);
+  self->ovf = NULL;
+  char* out = self->buf;
+  size_t cap = sizeof(self->buf);
+  if (!self->lane) {
+    log_buf_t* scratch = &get_tls()->scratch;
+    scratch->len = 0;
+    if (buf_reserve(scratch, sizeof(self->buf))) {
+      out = scratch->data;
+      cap = scratch->cap;
+    }
+  }
+  self->msg = out;
+
+  va_list ap_copy;
+  va_copy(ap_copy, ap);
+  int needed = item_format(self, fmt, out, cap, ap);
+  if (needed < 0) {
+    va_end(ap_copy);
     return false;
   }
 
+  // 格納先に収まらない場合、拡張して再フォーマット
+  if ((size_t)needed >= cap) {
+    out = item_reserve(self, (size_t)needed + 1);
+    if (out) {
+      item_format(self, fmt, out, (size_t)needed + 1, ap_copy);
+      self->msg = out;
+    }
+  }
+  va_end(ap_copy);
+
   return true;
 }
 
 /**
- * @brief 非同期モード用のキューのメモリを確保する。
- * @param nqueue キューの数。
- * @return キュー。
+ * @brief ログデータのメッセージの末尾に、抑制したログの数を付ける。
+ *
+ * - メモリ確保に失敗した場合、メッセージを変更しない。
+ * @param self ログデータ。（メッセージを設定済みであること）
+ * @param suppressed 抑制したログの数。
+ * @return 成功: true, 失敗: false。
  */
-static log_item_t** queue_init(const size_t nqueue) {
-  if (nqueue < 1) {
-    SET_ERR_LOG(
-        ERR_INVALID_ARG, "The number of queues must be set to 1 or more. [%zu]",
-        nqueue
-    );
-    return NULL;
+static bool item_append_suppressed(log_item_t* self, const size_t suppressed) {
+  char suffix[64];
+  int slen = snprintf(
+      suffix, sizeof(suffix), " (%zu similar messages suppressed)", suppressed
+  );
+  if (slen < 0) { return false; }
+
+  size_t len = strlen(self->msg);
+  size_t needed = len + (size_t)slen + 1;
+  if (self->msg == self->buf && needed <= sizeof(self->buf)) {
+    memcpy(self->buf + len, suffix, (size_t)slen + 1);
+    return true;
   }
 
-  log_item_t** self = calloc(nqueue, sizeof(*self));
-  if (!self) {
+  // 同期モード: メッセージは作業バッファにあるため、その末尾に追加する
+  if (!self->lane) {
+    log_buf_t* scratch = &get_tls()->scratch;
+    scratch->len = len;
+    if (self->msg == self->buf) {
+      scratch->len = 0;
+      if (!buf_append(scratch, self->buf, len)) { return false; }
+    }
+    if (!buf_append(scratch, suffix, (size_t)slen + 1)) { return false; }
+    self->msg = scratch->data;
+    return true;
+  }
+
+  char* ovf = (char*)realloc(self->ovf, needed);
+  if (!ovf) {
     SET_ERR_LOG_AUTO(ERR_MEM_ALLOC_FAILED);
-    return NULL;
+    return false;
   }
+  if (!self->ovf) { memcpy(ovf, self->buf, len); }
+  memcpy(ovf + len, suffix, (size_t)slen + 1);
+  self->ovf = ovf;
+  self->msg = ovf;
 
-  return self;
+  return true;
 }
 
 /**
- * @brief 非同期モード用のキューのメモリを解放する。
- * @param self キュー。
+ * @brief ログデータのメッセージの末尾に、まとめた重複ログの数を付ける。
+ *
+ * - 遅延フォーマットの場合、メッセージを作成してフォーマット済みに変換する。
+ * - 失敗した場合、メッセージを変更しない。
+ * @param self ログデータ。（ワーカーが保留中のもの）
+ * @param nrepeat まとめた重複ログの数。
+ * @param pmsg メッセージバッファ。
+ * @param pmsg_cap メッセージバッファサイズ。
+ * @return 成功: true, 失敗: false。
  */
-static void queue_destroy(log_item_t*** self) {
-  if (!self || !*self) { return; }
+static bool item_append_repeated(
+    log_item_t* self, const size_t nrepeat, char** pmsg, size_t* pmsg_cap
+) {
+  const char* msg = item_render(self, pmsg, pmsg_cap);
+  if (!msg) { return false; }
 
-  free(*self);
-  *self = NULL;
+  char suffix[64];
+  int slen =
+      snprintf(suffix, sizeof(suffix), " (repeated %zu times)", nrepeat);
+  if (slen < 0) { return false; }
+
+  // 構造化ログのフィールドはメッセージの後ろに移動する
+  size_t len = strlen(msg);
+  const char* kv = msg + len + 1;
+  size_t kv_len = self->deferred ? 0 : self->kv_len;
+  size_t needed = len + (size_t)slen + 1 + kv_len;
+  if (needed <= sizeof(self->buf)) {
+    // msgはインライン領域、ovf、メッセージバッファのいずれかを指す
+    memmove(self->buf + len + (size_t)slen + 1, kv, kv_len);
+    memmove(self->buf, msg, len);
+    memcpy(self->buf + len, suffix, (size_t)slen + 1);
+    if (self->ovf) { free(self->ovf); }
+    self->ovf = NULL;
+  } else {
+    char* ovf = (char*)malloc(needed);
+    if (!ovf) {
+      SET_ERR_LOG_AUTO(ERR_MEM_ALLOC_FAILED);
+      return false;
+    }
+    memcpy(ovf, msg, len);
+    memcpy(ovf + len, suffix, (size_t)slen + 1);
+    memcpy(ovf + len + (size_t)slen + 1, kv, kv_len);
+    if (self->ovf) { free(self->ovf); }
+    self->ovf = ovf;
+  }
+  self->msg = self->ovf ? self->ovf : self->buf;
+  self->deferred = false;
+  self->len = 0;
+  self->kv_len = kv_len;
+
+  return true;
 }
 
 /**
- * @brief mutexロックする。
- * @param mutex 排他制御用mutex
+ * @brief ログデータに可変長引数の生のバイト列を設定する。（遅延フォーマット）
+ *
+ * - まずインライン領域に保存し、収まらない場合のみメモリを確保する。
+ * @param self ログデータ。（呼び出し箇所データを設定済みであること）
+ * @param ap 可変長引数。
  * @return 成功: true, 失敗: false。
  */
-static bool mutex_lock(pthread_mutex_t* mutex) {
-  if (!mutex) {
+static bool item_set_args(log_item_t* self, va_list ap) {
+  if (!self || !self->site || !self->site->args) {
     SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
     return false;
   }
 
-  if (pthread_mutex_lock(mutex) != 0) {
-    SET_ERR_LOG_AUTO(ERR_MUTEX_LOCK_FAILED);
-    return false;
+  self->msg = NULL;
+  self->ovf = NULL;
+
+  va_list ap_copy;
+  va_copy(ap_copy, ap);
+  size_t needed = argfmt_capture(
+      self->site->args, ap, (unsigned char*)self->buf, sizeof(self->buf)
+  );
+
+  // インライン領域に収まらない場合、メモリを確保して再保存
+  if (needed > sizeof(self->buf)) {
+    self->ovf = (char*)malloc(needed);
+    if (!self->ovf) {
+      SET_ERR_LOG_AUTO(ERR_MEM_ALLOC_FAILED);
+      va_end(ap_copy);
+      return false;
+    }
+    argfmt_capture(
+        self->site->args, ap_copy, (unsigned char*)self->ovf, needed
+    );
   }
+  va_end(ap_copy);
+
+  self->deferred = true;
+  self->len = needed;
 
   return true;
 }
 
 /**
- * @brief mutexアンロックする。
- * @param mutex 排他制御用mutex
- * @return 成功: true, 失敗: false。
+ * @brief ログデータの本体（メッセージまたは引数の生のバイト列）を取得する。
+ *
+ * - 構造化ログの場合、メッセージとフィールドを合わせて本体とする。
+ * @param self ログデータ。
+ * @param size 本体のバイト数。
+ * @return 本体。
  */
-static bool mutex_unlock(pthread_mutex_t* mutex) {
-  if (!mutex) {
-    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
-    return false;
+static const char* item_get_data(const log_item_t* self, size_t* size) {
+  if (self->deferred) {
+    *size = self->len;
+    return self->ovf ? self->ovf : self->buf;
   }
 
-  if (pthread_mutex_unlock(mutex) != 0) {
-    SET_ERR_LOG_AUTO(ERR_MUTEX_UNLOCK_FAILED);
-    return false;
-  }
+  const char* data = self->msg ? self->msg : "";
+  *size = strlen(data);
+  // 構造化ログの場合、終端文字に続くフィールドを含める
+  if (self->kv_len > 0) { *size += 1 + self->kv_len; }
 
-  return true;
+  return data;
 }
 
 /**
- * @brief condシグナルを送信する。
- * @param cond 排他制御用cond
- * @return 成功: true, 失敗: false。
+ * @brief 構造化ログのフィールドの格納に必要なバイト数を取得する。
+ * @param fields フィールドの配列。
+ * @param nfield フィールドの数。
+ * @return バイト数。
  */
-static bool cond_signal(pthread_cond_t* cond) {
-  if (!cond) {
-    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
-    return false;
-  }
-
-  if (pthread_cond_signal(cond) != 0) {
-    SET_ERR_LOG_AUTO(ERR_CONDITION_SIGNAL_FAILED);
-    return false;
+static size_t get_fields_size(const log_field_t* fields, const size_t nfield) {
+  size_t size = 0;
+  for (size_t i = 0; i < nfield; i++) {
+    size += sizeof(log_field_t);
+    if (fields[i].type == LOG_FIELD_STR && fields[i].value.s) {
+      size += strlen(fields[i].value.s) + 1;
+    }
   }
 
-  return true;
+  return size;
 }
 
 /**
- * @brief condシグナルを待つ。
- * @param cond 排他制御用cond
- * @param mutex 排他制御用mutex
+ * @brief ログデータに構造化ログのメッセージとフィールドを設定する。
+ *
+ * - メッセージの終端文字に続けてフィールドを格納し、文字列の値はコピーする。
+ *   （キーは文字列リテラルのため、ポインタのみ保持する）
+ * - まずインライン領域に格納し、収まらない場合のみ格納先を確保する。
+ * @param self ログデータ。
+ * @param msg メッセージ。（フォーマットしない）
+ * @param fields フィールドの配列。
+ * @param nfield フィールドの数。
  * @return 成功: true, 失敗: false。
  */
-static bool cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex) {
-  if (!cond || !mutex) {
+static bool item_set_kv(
+    log_item_t* self, const char* msg, const log_field_t* fields,
+    const size_t nfield
+) {
+  if (!self || !msg || (!fields && nfield > 0)) {
     SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
     return false;
   }
 
-  if (pthread_cond_wait(cond, mutex) != 0) {
-    SET_ERR_LOG_AUTO(ERR_CONDITION_WAIT_FAILED);
-    return false;
+  size_t len = strlen(msg);
+  size_t kv_len = get_fields_size(fields, nfield);
+  size_t needed = len + 1 + kv_len;
+  char* data = self->buf;
+  self->ovf = NULL;
+  if (needed > sizeof(self->buf)) {
+    data = item_reserve(self, needed);
+    if (!data) { return false; }
+  }
+
+  memcpy(data, msg, len + 1);
+  char* pos = data + len + 1;
+  for (size_t i = 0; i < nfield; i++) {
+    memcpy(pos, &fields[i], sizeof(log_field_t));
+    pos += sizeof(log_field_t);
+    if (fields[i].type == LOG_FIELD_STR && fields[i].value.s) {
+      size_t slen = strlen(fields[i].value.s) + 1;
+      memcpy(pos, fields[i].value.s, slen);
+      pos += slen;
+    }
   }
+  self->msg = data;
+  self->kv_len = kv_len;
 
   return true;
 }
 
 /**
- * @brief ログレベル名を取得する。
- * @param level ログレベル。
- * @return ログレベル名。
+ * @brief ログデータの構造化ログのフィールドの先頭を取得する。
+ * @param self ログデータ。（フィールドを設定済みであること）
+ * @return フィールドの先頭。
  */
-static char* get_level_name(const log_level_t level) {
-  switch (level) {
-    case LOG_LEVEL_ERROR:
-      return "ERROR";
-    case LOG_LEVEL_WARN:
-      return "WARN";
-    case LOG_LEVEL_INFO:
-      return "INFO";
-    case LOG_LEVEL_DEBUG:
-      return "DEBUG";
-    default:
-      return "UNK";
+static const char* item_get_fields(const log_item_t* self) {
+  return self->msg + strlen(self->msg) + 1;
+}
+
+/**
+ * @brief 格納したフィールドを1つ読み出す。
+ *
+ * - 文字列の値は格納領域を指す。
+ * @param data フィールドの先頭。
+ * @param field 読み出したフィールド。
+ * @return 次のフィールドの先頭。
+ */
+static const char* field_decode(const char* data, log_field_t* field) {
+  memcpy(field, data, sizeof(*field));
+  data += sizeof(*field);
+  if (field->type == LOG_FIELD_STR && field->value.s) {
+    field->value.s = data;
+    data += strlen(data) + 1;
   }
+
+  return data;
 }
 
 /**
- * @brief ログバッファのメモリを再確保する。
+ * @brief ログデータのメッセージを取得する。
  *
- * - 使用したいメモリサイズが使用可能なメモリサイズを超えた場合、
- *   使用可能なメモリサイズを2倍にして、メモリを再確保する。
- * @param out ログバッファ。
- * @param cap 使用可能なメモリサイズ。
- * @param needed_cap 使用したいメモリサイズ。
- * @return 成功: true, 失敗: false。
+ * - 遅延フォーマットの場合、メッセージバッファにメッセージを作成する。
+ *   （ログデータは変更しないため、複数のスレッドから同時に呼び出せる）
+ * - メッセージバッファは呼び出し元が保持し、行をまたいで再利用する。
+ * @param self ログデータ。
+ * @param pout メッセージバッファ。（NULLを指す場合、確保する）
+ * @param pcap メッセージバッファの使用可能なメモリサイズ。
+ * @return メッセージ。（失敗: NULL）
  */
-static bool realloc_format_line(
-    char** out, size_t* cap, const size_t needed_cap
+static const char* item_render(
+    const log_item_t* self, char** pout, size_t* pcap
 ) {
-  if (!out || !*out || !cap) {
+  if (!self || !pout || !pcap) {
     SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
-    return false;
+    return NULL;
   }
 
-  if (needed_cap <= *cap) { return true; }
+  if (!self->deferred) { return self->msg ? self->msg : ""; }
 
-  *cap = (needed_cap) * 2;
-  char* new_out = (char*)realloc(*out, *cap);
-  if (!new_out) {
-    SET_ERR_LOG_AUTO(ERR_MEM_ALLOC_FAILED);
-    return false;
+  if (!*pout) {
+    *pcap = MIN_LOG_SIZE;
+    *pout = (char*)malloc(*pcap);
+    if (!*pout) {
+      SET_ERR_LOG_AUTO(ERR_MEM_ALLOC_FAILED);
+      *pcap = 0;
+      return NULL;
+    }
   }
 
-  *out = new_out;
+  const unsigned char* data =
+      (const unsigned char*)(self->ovf ? self->ovf : self->buf);
+  int needed = argfmt_render(self->site->args, data, self->len, *pout, *pcap);
+  if (needed < 0) { return NULL; }
 
-  return true;
+  // メッセージバッファに収まらない場合、拡張して再作成
+  if ((size_t)needed >= *pcap) {
+    if (!realloc_format_line(pout, pcap, (size_t)needed + 1)) { return NULL; }
+    argfmt_render(self->site->args, data, self->len, *pout, *pcap);
+  }
+
+  return *pout;
 }
 
 /**
- * @brief フォーマットに応じたログを作成する。
- * @param item ログデータ。
- * @return 作成したログ。
+ * @brief プールから未使用のログデータを取得する。
+ *
+ * - ERROR専用キューを使用する場合、ERRORは空きが出るまで待機する。
+ *   （ワーカーの停止等で空きが出ない場合に備え、block_msでタイムアウト
+ *   して破棄する）
+ * - プールが空の場合、キューが満杯の場合の動作に従う。
+ * - 破棄したログは、ログレベルごとに数える。
+ * @param logger ログ処理のインスタンス。
+ * @param level 出力するログのレベル。
+ * @return ログデータ。（取得できない場合、NULL）
  */
-static char* format_line(const log_item_t* item) {
-  if (!item) {
-    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
-    return NULL;
-  }
+static log_item_t* item_acquire(logger_t* logger, const log_level_t level) {
+  log_lane_t* lane = get_lane(logger, level);
+  log_item_t* item = (log_item_t*)ring_pop(lane->pool);
+  if (item) { return item; }
 
-  // 初期バッファのメモリ確保
-  size_t cap = MIN_LOG_SIZE;
-  char* out = (char*)malloc(cap);
-  if (!out) {
-    SET_ERR_LOG_AUTO(ERR_MEM_ALLOC_FAILED);
-    return NULL;
+  // ERROR専用キュー
+  if (lane == &logger->err_lane) {
+    item = item_wait(logger, lane, logger->block_ms);
+    if (!item) { count_dropped(logger, level); }
+    return item;
   }
 
-  out[0] = '\0';
-  size_t len = 0;
-  const char* fmt = g_param.format ? g_param.format : DEFAULT_FORMAT;
-  for (const char* ptr = fmt; *ptr; ++ptr) {
-    if (*ptr == '%' && *(ptr + 1)) {
-      char ch = *(ptr + 1);
-      ptr++;
-
-      char buff[MAX_CONV_SPEC_SIZE];
-      switch (ch) {
-        case 'T': {  // タイムスタンプ
-          struct tm tm = get_current_time();
-          snprintf(
-              buff, sizeof(buff), "%04d-%02d-%02d %02d:%02d:%02d",
-              tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour,
-              tm.tm_min, tm.tm_sec
-          );
-          break;
-        }
-        case 'l': {  // ログレベル
-          snprintf(buff, sizeof(buff), "%-5s", get_level_name(item->level));
-          break;
-        }
-        case 'F': {  // ファイル名
-          snprintf(buff, sizeof(buff), "%s", item->fname ? item->fname : "");
-          break;
-        }
-        case 'L': {  // 行数
-          snprintf(buff, sizeof(buff), "%d", item->line);
-          break;
-        }
-        case 'f': {  // 関数名
-          snprintf(buff, sizeof(buff), "%s", item->func ? item->func : "");
-          break;
-        }
-        case 'm': {  // メッセージ
-          snprintf(buff, sizeof(buff), "%s", item->msg ? item->msg : "");
-          break;
-        }
-        default: {
-          buff[0] = '%';
-          buff[1] = ch;
-          buff[2] = '\0';
-          break;
-        }
-      }
-
-      size_t add_size = strlen(buff);
-      if (!realloc_format_line(&out, &cap, len + add_size + 2)) {
-        free(out);
-        return NULL;
-      }
-      memcpy(out + len, buff, add_size);
-      len += add_size;
-      out[len] = '\0';
-    } else {
-      if (!realloc_format_line(&out, &cap, len + 2)) {
-        free(out);
-        return NULL;
+  switch (logger->overflow) {
+    case LOG_OVERFLOW_DROP_OLDEST: {
+      // キューの先頭（古い）データを破棄して再利用
+      item = (log_item_t*)ring_pop(lane->queue);
+      if (item) {
+        count_dropped(logger, item->site->level);
+        item_clear(item);
+        return item;
       }
-      out[len++] = *ptr;
-      out[len] = '\0';
+      break;
     }
-  }
-
-  // 終端処理
-  if (len == 0 || out[len - 1] != '\n') {
-    if (!realloc_format_line(&out, &cap, len + 2)) {
-      free(out);
-      return NULL;
+    case LOG_OVERFLOW_BLOCK: {
+      item = item_wait(logger, lane, logger->block_ms);
+      if (item) { return item; }
+      break;
     }
-    out[len++] = '\n';
-    out[len] = '\0';
+    case LOG_OVERFLOW_DROP_NEWEST:
+    default:
+      break;
   }
+  count_dropped(logger, level);
 
-  return out;
+  return NULL;
 }
 
 /**
- * @brief ログを出力する。
- * @param item ログデータ。
- * @return 成功: true, 失敗: false。
+ * @brief プールに空きが出るまで待機してログデータを取得する。
+ *
+ * - item_releaseの通知をcondで待つ。（通知を取りこぼした場合に備え、
+ *   BLOCK_WAKE_NSごとにワーカーを起こし直して再確認する）
+ * @param logger ログ処理のインスタンス。
+ * @param lane キュー。
+ * @param timeout_ms 待機時間[ms]。
+ * @return ログデータ。（タイムアウトした場合、NULL）
  */
-static bool output_line(const log_item_t* item) {
-  if (!item) {
-    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
-    return false;
-  }
+static log_item_t* item_wait(
+    logger_t* logger, log_lane_t* lane, const unsigned timeout_ms
+) {
+  uint64_t deadline = get_monotonic_ns() + (uint64_t)timeout_ms * 1000000;
+  while (true) {
+    log_item_t* item = (log_item_t*)ring_pop(lane->pool);
+    if (item) { return item; }
+    uint64_t now = get_monotonic_ns();
+    if (now >= deadline) { return NULL; }
 
-  char* line = format_line(item);
-  if (!line) { return false; }
+    wake_worker(logger, true);
+    uint64_t wait_ns = deadline - now;
+    if (wait_ns > BLOCK_WAKE_NS) { wait_ns = BLOCK_WAKE_NS; }
 
-  // 標準出力
-  if ((g_param.out & LOG_STD_OUT) == LOG_STD_OUT) { printf("%s", line); }
-  // ファイル出力
-  if ((g_param.out & LOG_FILE_OUT) == LOG_FILE_OUT) {
-    if (g_param.fp) { fputs(line, g_param.fp); }
+    // 待機の登録後に再確認し、返却との行き違いを防ぐ
+    atomic_fetch_add(&lane->waiters, 1);
+    if (mutex_lock(&lane->mutex)) {
+      item = (log_item_t*)ring_pop(lane->pool);
+      bool timeout = false;
+      if (!item) {
+        cond_timedwait(&lane->cond, &lane->mutex, wait_ns, &timeout);
+      }
+      mutex_unlock(&lane->mutex);
+    }
+    atomic_fetch_sub(&lane->waiters, 1);
+    if (item) { return item; }
   }
-
-  free(line);
-  fflush(g_param.fp);
-
-  return true;
 }
 
 /**
- * @brief キューにログデータを追加する。
+ * @brief ログデータをプールに返却する。
+ *
+ * - 空きを待っているスレッドがある場合、通知する。
  * @param item ログデータ。
- * @return 成功: true, 失敗: false。
  */
-static bool enqueue_item(log_item_t* item) {
-  if (!g_param.async || !item) {
-    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
-    return false;
-  }
+static void item_release(log_item_t* item) {
+  if (!item) { return; }
 
-  bool res = false;
-  if (g_param.q_count < g_param.nqueue) {
-    // キューに空きがある場合、末尾に追加
-    g_param.queue[g_param.q_tail] = item;
-    g_param.q_tail = (g_param.q_tail + 1) % g_param.nqueue;
-    g_param.q_count++;
-    res = true;
-  } else {
-    // キューに空きがない場合、先頭（古い）データを削除して追加
-    log_item_destroy(&g_param.queue[g_param.q_head]);
-    g_param.queue[g_param.q_head] = item;
-    g_param.q_head = (g_param.q_head + 1) % g_param.nqueue;
-    g_param.q_tail = (g_param.q_tail + 1) % g_param.nqueue;
-    res = true;
+  log_lane_t* lane = item->lane;
+  item_clear(item);
+  ring_push(lane->pool, item);
+  if (atomic_load(&lane->waiters) > 0 && mutex_lock(&lane->mutex)) {
+    cond_signal(&lane->cond);
+    mutex_unlock(&lane->mutex);
   }
-
-  return res;
 }
 
 /**
- * @brief キューの先頭からログデータを取得する。
- * @return ログデータ。
+ * @brief ログデータの参照を解放し、最後の参照の場合はプールに返却する。
+ * @param item ログデータ。
+ */
+static void item_unref(log_item_t* item) {
+  if (!item) { return; }
+
+  if (atomic_fetch_sub_explicit(&item->refs, 1, memory_order_acq_rel) == 1) {
+    item_release(item);
+  }
+}
+
+/**
+ * @brief ログフォーマットをコンパイルする。
+ *
+ * デフォルトフォーマット: [%T][%l][%F:%L][%f()] - %m
+ *
+ * 変換指定子:
+ * - %T : タイムスタンプ (YYYY-MM-DD HH:MM:SS)
+ * - %e : ミリ秒 (000-999)
+ * - %u : マイクロ秒 (000000-999999)
+ * - %l : ログレベル (DEBUG/INFO/WARN/ERROR)
+ * - %F : ファイル名
+ * - %L : 行番号
+ * - %f : 関数名
+ * - %m : メッセージ
+ * - %t : スレッドID
+ * - %P : プロセスID
+ * - %N : 通し番号
+ * - %M : 単調増加時刻[ns]
+ *
+ * - リテラルと変換指定子の命令配列に変換し、1行ごとの解析を不要にする。
+ * - 未対応の変換指定子は、そのままリテラルとして出力する。
+ * @param fmt ログフォーマット。
+ * @return コンパイル済みログフォーマット。
+ */
+static log_format_t* format_init(const char* fmt) {
+  if (!fmt) {
+    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
+    return NULL;
+  }
+
+  log_format_t* self = (log_format_t*)calloc(1, sizeof(log_format_t));
+  if (!self) {
+    SET_ERR_LOG_AUTO(ERR_MEM_ALLOC_FAILED);
+    return NULL;
+  }
+
+  self->str = my_strdup(fmt);
+  if (!self->str) {
+    format_destroy(&self);
+    return NULL;
+  }
+
+  // 命令数の上限（変換指定子ごとにリテラル + 変換指定子、末尾のリテラル）
+  size_t max_op = 1;
+  for (const char* ptr = fmt; *ptr; ++ptr) {
+    if (*ptr == '%') { max_op += 2; }
+  }
+  self->ops = (log_format_op_t*)calloc(max_op, sizeof(log_format_op_t));
+  if (!self->ops) {
+    SET_ERR_LOG_AUTO(ERR_MEM_ALLOC_FAILED);
+    format_destroy(&self);
+    return NULL;
+  }
+
+  const char* lit = self->str;
+  for (const char* ptr = self->str; *ptr; ++ptr) {
+    if (*ptr != '%' || !*(ptr + 1)) { continue; }
+
+    log_format_op_type_t type = get_format_op_type(*(ptr + 1));
+    if (type != LOG_FORMAT_OP_LITERAL) {
+      if (ptr > lit) {
+        self->ops[self->nop++] = (log_format_op_t){
+            .type = LOG_FORMAT_OP_LITERAL,
+            .str = lit,
+            .len = (size_t)(ptr - lit),
+        };
+      }
+      self->ops[self->nop++] = (log_format_op_t){.type = type};
+      self->stamp |= get_format_stamp(type);
+      lit = ptr + 2;
+      if (type == LOG_FORMAT_OP_TIME || type == LOG_FORMAT_OP_MSEC ||
+          type == LOG_FORMAT_OP_USEC) {
+        self->use_time = true;
+      }
+    }
+    ptr++;
+  }
+  if (*lit) {
+    self->ops[self->nop++] = (log_format_op_t){
+        .type = LOG_FORMAT_OP_LITERAL,
+        .str = lit,
+        .len = strlen(lit),
+    };
+  }
+
+  return self;
+}
+
+/**
+ * @brief コンパイル済みログフォーマットのメモリを解放する。
+ * @param self コンパイル済みログフォーマット。
+ */
+static void format_destroy(log_format_t** self) {
+  if (!self || !*self) { return; }
+
+  if ((*self)->str) { free((*self)->str); }
+  if ((*self)->ops) { free((*self)->ops); }
+  free(*self);
+  *self = NULL;
+}
+
+/**
+ * @brief 変換指定子の命令種別を取得する。
+ * @param ch 変換指定子の文字。（%の次の文字）
+ * @return 命令種別。（未対応の場合、LOG_FORMAT_OP_LITERAL）
+ */
+static log_format_op_type_t get_format_op_type(const char ch) {
+  switch (ch) {
+    case 'T':
+      return LOG_FORMAT_OP_TIME;
+    case 'e':
+      return LOG_FORMAT_OP_MSEC;
+    case 'u':
+      return LOG_FORMAT_OP_USEC;
+    case 'l':
+      return LOG_FORMAT_OP_LEVEL;
+    case 'F':
+      return LOG_FORMAT_OP_FNAME;
+    case 'L':
+      return LOG_FORMAT_OP_LINE;
+    case 'f':
+      return LOG_FORMAT_OP_FUNC;
+    case 'm':
+      return LOG_FORMAT_OP_MSG;
+    case 't':
+      return LOG_FORMAT_OP_TID;
+    case 'P':
+      return LOG_FORMAT_OP_PID;
+    case 'N':
+      return LOG_FORMAT_OP_SEQ;
+    case 'M':
+      return LOG_FORMAT_OP_MONO;
+    default:
+      return LOG_FORMAT_OP_LITERAL;
+  }
+}
+
+/**
+ * @brief 命令種別が使用する、呼び出し元で取得する値を取得する。
+ * @param type 命令種別。
+ * @return 呼び出し元で取得する値。（log_stamp_tの論理和）
+ */
+static unsigned get_format_stamp(const log_format_op_type_t type) {
+  switch (type) {
+    case LOG_FORMAT_OP_TID:
+    case LOG_FORMAT_OP_PID:
+      return LOG_STAMP_THREAD;
+    case LOG_FORMAT_OP_SEQ:
+      return LOG_STAMP_SEQ;
+    case LOG_FORMAT_OP_MONO:
+      return LOG_STAMP_MONO;
+    default:
+      return 0;
+  }
+}
+
+/**
+ * @brief ファイルを開く。
+ * @param fpath ファイルパス。
+ * @return ファイルストリーム。
+ */
+static FILE* fp_init(const char* fpath) {
+  if (!fpath) {
+    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
+    return NULL;
+  }
+
+  FILE* self = fopen(fpath, "a");
+  if (!self) {
+    SET_ERR_LOG_AUTO(ERR_FILE_OPEN_FAILED);
+    return NULL;
+  }
+
+  return self;
+}
+
+/**
+ * @brief ファイルをフラッシュして閉じる。
+ * @param self ファイルストリーム。
+ */
+static void fp_destroy(FILE** self) {
+  if (!self || !*self) { return; }
+
+  fflush(*self);
+  fclose(*self);
+  *self = NULL;
+}
+
+/**
+ * @brief 非同期モード用のキューのメモリを確保する。
+ * @param nqueue キューの数。
+ * @return キュー。
+ */
+static ring_t* queue_init(const size_t nqueue) {
+  if (nqueue < 1) {
+    SET_ERR_LOG(
+        ERR_INVALID_ARG, "The number of queues must be set to 1 or more. [%zu]",
+        nqueue
+    );
+    return NULL;
+  }
+
+  ring_t* self = ring_init(nqueue);
+  if (!self) { return NULL; }
+
+  return self;
+}
+
+/**
+ * @brief 非同期モード用のキューのメモリを解放する。
+ *
+ * - ログデータはログデータ配列ごと解放するため、ここでは解放しない。
+ * @param self キュー。
+ */
+static void queue_destroy(ring_t** self) {
+  if (!self || !*self) { return; }
+
+  ring_destroy(self);
+}
+
+/**
+ * @brief 非同期モード用のキューを作成する。
+ *
+ * - ログデータを事前確保し、すべてプールに格納する。
+ * @param self キュー。
+ * @param nitem ログデータの数。
+ * @return 成功: true, 失敗: false。
+ */
+static bool lane_init(log_lane_t* self, const size_t nitem) {
+  if (!self) {
+    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
+    return false;
+  }
+
+  if (pthread_mutex_init(&self->mutex, NULL) != 0) {
+    SET_ERR_LOG_AUTO(ERR_MUTEX_INIT_FAILED);
+    return false;
+  }
+  if (pthread_cond_init(&self->cond, NULL) != 0) {
+    pthread_mutex_destroy(&self->mutex);
+    SET_ERR_LOG_AUTO(ERR_CONDITION_INIT_FAILED);
+    return false;
+  }
+  self->cond_ready = true;
+  atomic_init(&self->waiters, 0);
+
+  self->nitem = nitem;
+  self->items = items_init(nitem);
+  if (!self->items) { return false; }
+  for (size_t i = 0; i < nitem; i++) { self->items[i].lane = self; }
+  self->pool = pool_init(self->items, nitem);
+  if (!self->pool) { return false; }
+  self->queue = queue_init(nitem);
+  if (!self->queue) { return false; }
+
+  return true;
+}
+
+/**
+ * @brief 非同期モード用のキューを解放する。
+ * @param self キュー。
+ */
+static void lane_destroy(log_lane_t* self) {
+  if (!self) { return; }
+
+  queue_destroy(&self->queue);
+  ring_destroy(&self->pool);
+  items_destroy(&self->items, self->nitem);
+  self->nitem = 0;
+  if (self->cond_ready) {
+    pthread_cond_destroy(&self->cond);
+    pthread_mutex_destroy(&self->mutex);
+    self->cond_ready = false;
+  }
+}
+
+/**
+ * @brief ログレベルに対応するキューを取得する。
+ * @param level ログレベル。
+ * @return キュー。
+ */
+static log_lane_t* get_lane(logger_t* logger, const log_level_t level) {
+  if (logger->priority && level == LOG_LEVEL_ERROR) {
+    return &logger->err_lane;
+  }
+
+  return &logger->lane;
+}
+
+/**
+ * @brief 破棄したログを数える。
+ * @param level 破棄したログのレベル。
+ */
+static void count_dropped(logger_t* logger, const log_level_t level) {
+  if ((unsigned)level < LOG_LEVEL_NUM) {
+    atomic_fetch_add_explicit(&logger->dropped[level], 1, memory_order_relaxed);
+  }
+}
+
+/**
+ * @brief mutexロックする。
+ * @param mutex 排他制御用mutex
+ * @return 成功: true, 失敗: false。
+ */
+static bool mutex_lock(pthread_mutex_t* mutex) {
+  if (!mutex) {
+    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
+    return false;
+  }
+
+  if (pthread_mutex_lock(mutex) != 0) {
+    SET_ERR_LOG_AUTO(ERR_MUTEX_LOCK_FAILED);
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * @brief mutexアンロックする。
+ * @param mutex 排他制御用mutex
+ * @return 成功: true, 失敗: false。
+ */
+static bool mutex_unlock(pthread_mutex_t* mutex) {
+  if (!mutex) {
+    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
+    return false;
+  }
+
+  if (pthread_mutex_unlock(mutex) != 0) {
+    SET_ERR_LOG_AUTO(ERR_MUTEX_UNLOCK_FAILED);
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * @brief condシグナルを送信する。
+ * @param cond 排他制御用cond
+ * @return 成功: true, 失敗: false。
+ */
+static bool cond_signal(pthread_cond_t* cond) {
+  if (!cond) {
+    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
+    return false;
+  }
+
+  if (pthread_cond_signal(cond) != 0) {
+    SET_ERR_LOG_AUTO(ERR_CONDITION_SIGNAL_FAILED);
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * @brief condシグナルを待つ。
+ * @param cond 排他制御用cond
+ * @param mutex 排他制御用mutex
+ * @return 成功: true, 失敗: false。
+ */
+static bool cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex) {
+  if (!cond || !mutex) {
+    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
+    return false;
+  }
+
+  if (pthread_cond_wait(cond, mutex) != 0) {
+    SET_ERR_LOG_AUTO(ERR_CONDITION_WAIT_FAILED);
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * @brief 指定時間までcond待機する。
+ * @param cond 待機用cond
+ * @param mutex 排他制御用mutex
+ * @param timeout_ns 待機時間[ns]。
+ * @param timeout タイムアウトしたか。
+ * @return 成功: true, 失敗: false。（タイムアウトは成功とする）
+ */
+static bool cond_timedwait(
+    pthread_cond_t* cond, pthread_mutex_t* mutex, const uint64_t timeout_ns,
+    bool* timeout
+) {
+  if (!cond || !mutex || !timeout) {
+    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
+    return false;
+  }
+
+  // 絶対時刻（CLOCK_REALTIME）に変換
+  struct timespec ts;
+  if (clock_gettime(CLOCK_REALTIME, &ts) != 0) {
+    SET_ERR_LOG_AUTO(ERR_CONDITION_WAIT_FAILED);
+    return false;
+  }
+  uint64_t nsec = (uint64_t)ts.tv_nsec + timeout_ns;
+  ts.tv_sec += (time_t)(nsec / 1000000000u);
+  ts.tv_nsec = (long)(nsec % 1000000000u);
+
+  int res = pthread_cond_timedwait(cond, mutex, &ts);
+  *timeout = res == ETIMEDOUT;
+  if (res != 0 && res != ETIMEDOUT) {
+    SET_ERR_LOG_AUTO(ERR_CONDITION_WAIT_FAILED);
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * @brief 呼び出し箇所データを登録する。
+ *
+ * - 初回のみファイル名の取得とIDの採番を行い、登録済みリストに追加する。
+ * - 同時に登録しようとした他のスレッドは、登録完了まで待つ。
+ * @param site 呼び出し箇所データ。
+ * @return 登録済みの呼び出し箇所データ。
+ */
+static log_site_t* site_register(log_site_t* site) {
+  if (atomic_load_explicit(&site->state, memory_order_acquire) ==
+      LOG_SITE_READY) {
+    return site;
+  }
+
+  int expected = LOG_SITE_NEW;
+  if (atomic_compare_exchange_strong_explicit(
+          &site->state, &expected, LOG_SITE_BUSY, memory_order_acquire,
+          memory_order_acquire
+      )) {
+    site->fname = site->fpath ? get_fname(site->fpath) : "";
+    site->func = site->func ? site->func : "";
+    site->args = site->fmt ? argfmt_compile(site->fmt) : NULL;
+    site->json = json_build_site(site);
+    site->id =
+        atomic_fetch_add_explicit(&g_nsites, 1, memory_order_relaxed) + 1;
+
+    // 登録済みリストの先頭に追加
+    site->next = atomic_load_explicit(&g_sites, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(
+        &g_sites, &site->next, site, memory_order_release,
+        memory_order_relaxed
+    )) {}
+
+    atomic_store_explicit(&site->state, LOG_SITE_READY, memory_order_release);
+    return site;
+  }
+
+  while (atomic_load_explicit(&site->state, memory_order_acquire) !=
+         LOG_SITE_READY) {
+    thrd_yield();
+  }
+
+  return site;
+}
+
+/**
+ * @brief モジュールごとのログレベルの名前と呼び出し箇所の一致度を取得する。
+ *
+ * - モジュール名の一致 > ファイル名の一致 > 拡張子を除くファイル名の一致
+ *   の順に優先する。
+ * @param site 登録済みの呼び出し箇所データ。
+ * @param name モジュール名またはファイル名。
+ * @return 一致度。（不一致: 0, 一致: 大きいほど優先）
+ */
+static int get_module_rank(const log_site_t* site, const char* name) {
+  if (site->module && strcmp(site->module, name) == 0) { return 3; }
+  if (strcmp(site->fname, name) == 0) { return 2; }
+
+  const char* dot = strrchr(site->fname, '.');
+  size_t len = dot ? (size_t)(dot - site->fname) : strlen(site->fname);
+  if (strlen(name) == len && strncmp(site->fname, name, len) == 0) {
+    return 1;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief 呼び出し箇所に適用するモジュールごとのログレベルを検索する。
+ *
+ * - g_module_mutexをロックして呼び出すこと。
+ * @param site 登録済みの呼び出し箇所データ。
+ * @param level 適用するログレベル。
+ * @return 該当あり: true, 該当なし: false。
+ */
+static bool find_module_level(const log_site_t* site, log_level_t* level) {
+  int best = 0;
+  for (size_t i = 0; i < g_nmodule_level; i++) {
+    int rank = get_module_rank(site, g_module_levels[i].name);
+    if (rank > best) {
+      best = rank;
+      *level = g_module_levels[i].level;
+    }
+  }
+
+  return best > 0;
+}
+
+/**
+ * @brief モジュールごとのログレベルの世代を更新する。
+ *
+ * - 呼び出し箇所にキャッシュしたフィルタ状態を無効にする。
+ * - 世代はフィルタ状態のビットより上位で数え、0（未設定）は使用しない。
+ * - g_module_mutexをロックして呼び出すこと。
+ */
+static void update_filter_gen(void) {
+  unsigned gen = atomic_load_explicit(&g_log_filter_gen, memory_order_relaxed);
+  gen += LOG_FILTER_MASK + 1;
+  if (gen == 0) { gen += LOG_FILTER_MASK + 1; }
+  atomic_store_explicit(&g_log_filter_gen, gen, memory_order_release);
+}
+
+/**
+ * @brief ログレベル名をログレベルに変換する。
+ *
+ * - 大文字・小文字を区別しない。
+ * @param str ログレベル名。（DEBUG/INFO/WARN/WARNING/ERROR）
+ * @param level ログレベル。
+ * @return 成功: true, 失敗: false。
+ */
+static bool parse_level(const char* str, log_level_t* level) {
+  static const struct {
+    const char* name;
+    log_level_t level;
+  } names[] = {
+      {"DEBUG", LOG_LEVEL_DEBUG}, {"INFO", LOG_LEVEL_INFO},
+      {"WARN", LOG_LEVEL_WARN},   {"WARNING", LOG_LEVEL_WARN},
+      {"ERROR", LOG_LEVEL_ERROR},
+  };
+  if (!str) { return false; }
+
+  for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+    if (strcasecmp(str, names[i].name) == 0) {
+      *level = names[i].level;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/**
+ * @brief ログレベル名を取得する。
+ * @param level ログレベル。
+ * @return ログレベル名。
+ */
+static char* get_level_name(const log_level_t level) {
+  switch (level) {
+    case LOG_LEVEL_ERROR:
+      return "ERROR";
+    case LOG_LEVEL_WARN:
+      return "WARN";
+    case LOG_LEVEL_INFO:
+      return "INFO";
+    case LOG_LEVEL_DEBUG:
+      return "DEBUG";
+    default:
+      return "UNK";
+  }
+}
+
+/**
+ * @brief ログバッファのメモリを再確保する。
+ *
+ * - 使用したいメモリサイズが使用可能なメモリサイズを超えた場合、
+ *   使用可能なメモリサイズを2倍にして、メモリを再確保する。
+ * @param out ログバッファ。
+ * @param cap 使用可能なメモリサイズ。
+ * @param needed_cap 使用したいメモリサイズ。
+ * @return 成功: true, 失敗: false。
+ */
+static bool realloc_format_line(
+    char** out, size_t* cap, const size_t needed_cap
+) {
+  if (!out || !*out || !cap) {
+    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
+    return false;
+  }
+
+  if (needed_cap <= *cap) { return true; }
+
+  size_t new_cap = needed_cap * 2;
+  char* new_out = (char*)realloc(*out, new_cap);
+  if (!new_out) {
+    SET_ERR_LOG_AUTO(ERR_MEM_ALLOC_FAILED);
+    return false;
+  }
+
+  *out = new_out;
+  *cap = new_cap;
+
+  return true;
+}
+
+/**
+ * @brief タイムスタンプのキャッシュを取得する。
+ *
+ * - 秒が変わった場合のみタイムスタンプを再作成する。
+ * @param sec 時刻[s]。
+ * @return タイムスタンプのキャッシュ。（失敗: NULL）
+ */
+static const log_time_cache_t* get_time_cache(const time_t sec) {
+  log_time_cache_t* cache = &g_time_cache;
+  if (cache->sec == sec) { return cache; }
+
+  struct tm tm;
+  if (!localtime_r(&sec, &tm)) {
+    SET_ERR_LOG_AUTO(ERR_UNKNOWN);
+    return NULL;
+  }
+  // YYYY-MM-DD hh:mm:ss
+  int year = tm.tm_year + 1900;
+  if (year < 0 || year > 9999) {
+    SET_ERR_LOG_AUTO(ERR_OUT_OF_RANGE);
+    return NULL;
+  }
+  char* str = cache->str;
+  argfmt_put_digits(str, (unsigned)year, 4);
+  str[4] = '-';
+  argfmt_put_digits(str + 5, (unsigned)tm.tm_mon + 1, 2);
+  str[7] = '-';
+  argfmt_put_digits(str + 8, (unsigned)tm.tm_mday, 2);
+  str[10] = ' ';
+  argfmt_put_digits(str + 11, (unsigned)tm.tm_hour, 2);
+  str[13] = ':';
+  argfmt_put_digits(str + 14, (unsigned)tm.tm_min, 2);
+  str[16] = ':';
+  argfmt_put_digits(str + 17, (unsigned)tm.tm_sec, 2);
+  str[19] = '\0';
+  cache->len = 19;
+  cache->sec = sec;
+
+  return cache;
+}
+
+/**
+ * @brief 出力待ちデータのバッファを必要なサイズ以上に拡張する。
+ * @param self バッファ。
+ * @param size 追加するバイト数。
+ * @return 成功: true, 失敗: false。
+ */
+static bool buf_reserve(log_buf_t* self, const size_t size) {
+  if (!self) {
+    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
+    return false;
+  }
+
+  size_t needed = self->len + size;
+  if (needed <= self->cap) { return true; }
+
+  size_t new_cap = needed * 2 < MIN_LOG_SIZE ? MIN_LOG_SIZE : needed * 2;
+  char* new_data = (char*)realloc(self->data, new_cap);
+  if (!new_data) {
+    SET_ERR_LOG_AUTO(ERR_MEM_ALLOC_FAILED);
+    return false;
+  }
+  self->data = new_data;
+  self->cap = new_cap;
+
+  return true;
+}
+
+/**
+ * @brief 出力待ちデータのバッファの末尾にデータを追加する。
+ * @param self バッファ。
+ * @param data データ。
+ * @param size データのバイト数。
+ * @return 成功: true, 失敗: false。
+ */
+static bool buf_append(log_buf_t* self, const void* data, const size_t size) {
+  if (!buf_reserve(self, size)) { return false; }
+  if (size > 0) { memcpy(self->data + self->len, data, size); }
+  self->len += size;
+
+  return true;
+}
+
+/**
+ * @brief 出力待ちデータのバッファのメモリを解放する。
+ * @param self バッファ。
+ */
+static void buf_destroy(log_buf_t* self) {
+  if (!self) { return; }
+
+  if (self->data) { free(self->data); }
+  self->data = NULL;
+  self->len = 0;
+  self->cap = 0;
+}
+
+/**
+ * @brief スレッドごとの作業バッファのキーを作成する。
+ */
+static void tls_key_init(void) {
+  if (pthread_key_create(&g_tls_key, tls_destroy) != 0 ||
+      pthread_atfork(NULL, NULL, tls_atfork_child) != 0) {
+    SET_ERR_LOG_AUTO(ERR_UNKNOWN);
+  }
+}
+
+/**
+ * @brief スレッドごとの作業バッファを解放する。（スレッド終了時）
+ * @param arg スレッドごとの作業バッファ。
+ */
+static void tls_destroy(void* arg) {
+  log_tls_t* self = (log_tls_t*)arg;
+  buf_destroy(&self->line);
+  buf_destroy(&self->scratch);
+  self->registered = false;
+}
+
+/**
+ * @brief fork後の子プロセスで、スレッドIDとプロセスIDのキャッシュを
+ *        破棄する。（forkしたスレッドのみ子プロセスに残る）
+ */
+static void tls_atfork_child(void) {
+  g_tls.tid = 0;
+  g_tls.pid = 0;
+}
+
+/**
+ * @brief 呼び出し元スレッドの作業バッファを取得する。
+ *
+ * - 初回はスレッド終了時に解放するよう登録する。
+ * @return スレッドごとの作業バッファ。
+ */
+static log_tls_t* get_tls(void) {
+  log_tls_t* self = &g_tls;
+  if (!self->registered) {
+    pthread_once(&g_tls_once, tls_key_init);
+    self->registered = pthread_setspecific(g_tls_key, self) == 0;
+  }
+
+  return self;
+}
+
+/**
+ * @brief ファイルディスクリプタにデータをすべて書き込む。
+ *
+ * - 一部のみ書き込まれた場合、残りを書き込む。
+ * @param fd ファイルディスクリプタ。
+ * @param data データ。
+ * @param size データのバイト数。
+ * @return 成功: true, 失敗: false。
+ */
+static bool write_fd(const int fd, const char* data, const size_t size) {
+  size_t pos = 0;
+  while (pos < size) {
+    ssize_t n = write(fd, data + pos, size - pos);
+    if (n < 0) {
+      if (errno == EINTR) { continue; }
+      SET_ERR_LOG_AUTO(ERR_FILE_WRITE_FAILED);
+      return false;
+    }
+    pos += (size_t)n;
+  }
+
+  return true;
+}
+
+/**
+ * @brief フライトレコーダを初期化する。
+ * @param self フライトレコーダ。
+ * @param cap 容量（バイト数）。
+ * @return 成功: true, 失敗: false。
+ */
+static bool recorder_init(log_recorder_t* self, const size_t cap) {
+  self->data = (char*)malloc(cap);
+  if (!self->data) {
+    SET_ERR_LOG_AUTO(ERR_MEM_ALLOC_FAILED);
+    return false;
+  }
+  self->cap = cap;
+  self->head = 0;
+  self->len = 0;
+
+  return true;
+}
+
+/**
+ * @brief フライトレコーダを解放する。
+ * @param self フライトレコーダ。
+ */
+static void recorder_destroy(log_recorder_t* self) {
+  if (self->data) { free(self->data); }
+  self->data = NULL;
+  self->cap = 0;
+  self->head = 0;
+  self->len = 0;
+}
+
+/**
+ * @brief フライトレコーダの指定位置以降で最初の行末を探す。
+ * @param self フライトレコーダ。
+ * @param pos 探し始める位置。（最も古い行の先頭からのバイト数）
+ * @return 行末の次の位置。（行末がない場合、データのバイト数）
+ */
+static size_t recorder_find_line(const log_recorder_t* self, size_t pos) {
+  while (pos < self->len) {
+    size_t start = (self->head + pos) % self->cap;
+    // 折り返し位置までを探す
+    size_t n = self->cap - start;
+    if (n > self->len - pos) { n = self->len - pos; }
+    const char* nl = (const char*)memchr(self->data + start, '\n', n);
+    if (nl) { return pos + (size_t)(nl - (self->data + start)) + 1; }
+    pos += n;
+  }
+
+  return self->len;
+}
+
+/**
+ * @brief フライトレコーダにフォーマット済みのログを追加する。
+ *
+ * - 空きが足りない場合、古いログから行単位で上書きする。
+ * - 容量を超える場合、末尾の収まる行のみ保持する。
+ * @param self フライトレコーダ。
+ * @param data フォーマット済みのログ。（行単位）
+ * @param size データのバイト数。
+ */
+static void recorder_append(
+    log_recorder_t* self, const char* data, const size_t size
+) {
+  if (self->cap == 0 || size == 0) { return; }
+
+  const char* end = data + size;
+  if (size > self->cap) {
+    // 末尾の容量分に含まれる最初の行の先頭から保持
+    const char* from = end - self->cap - 1;
+    const char* nl = (const char*)memchr(from, '\n', self->cap);
+    self->head = 0;
+    self->len = 0;
+    if (!nl) { return; }
+    data = nl + 1;
+  }
+
+  size_t len = (size_t)(end - data);
+  size_t free_len = self->cap - self->len;
+  if (len > free_len) {
+    size_t drop = recorder_find_line(self, len - free_len - 1);
+    self->head = (self->head + drop) % self->cap;
+    self->len -= drop;
+  }
+  if (self->len == 0) { self->head = 0; }
+
+  size_t tail = (self->head + self->len) % self->cap;
+  size_t n = self->cap - tail;
+  if (n > len) { n = len; }
+  memcpy(self->data + tail, data, n);
+  memcpy(self->data, data + n, len - n);
+  self->len += len;
+}
+
+/**
+ * @brief フライトレコーダのログを出力待ちデータの先頭に移す。
+ *
+ * - 移したログはフライトレコーダから削除する。
+ * @param self フライトレコーダ。
+ * @param out 出力待ちデータのバッファ。
+ * @return 成功: true, 失敗: false。
+ */
+static bool recorder_take(log_recorder_t* self, log_buf_t* out) {
+  if (self->len == 0) { return true; }
+  if (!buf_reserve(out, self->len)) { return false; }
+
+  memmove(out->data + self->len, out->data, out->len);
+  size_t n = self->cap - self->head;
+  if (n > self->len) { n = self->len; }
+  memcpy(out->data, self->data + self->head, n);
+  memcpy(out->data + n, self->data, self->len - n);
+  out->len += self->len;
+  self->head = 0;
+  self->len = 0;
+
+  return true;
+}
+
+/**
+ * @brief フォーマットに応じたログを作成する。
+ *
+ * - コンパイル済みログフォーマットの命令を順に実行し、バッファの末尾に直接
+ *   書き込む。
+ * - 失敗した場合、バッファを元の状態に戻す。
+ * @param format コンパイル済みログフォーマット。
+ * @param item ログデータ。
+ * @param msg メッセージ。（item_renderで取得したもの）
+ * @param out 出力待ちデータのバッファ。
+ * @return 成功: true, 失敗: false。
+ */
+static bool format_line(
+    const log_format_t* format, const log_item_t* item, const char* msg,
+    log_buf_t* out
+) {
+  if (!format || !item || !msg || !out) {
+    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
+    return false;
+  }
+
+  const log_site_t* site = item->site;
+  const struct timespec ts = item->ts;
+
+  size_t start = out->len;
+  for (size_t i = 0; i < format->nop; i++) {
+    const log_format_op_t* op = &format->ops[i];
+    bool res = true;
+    switch (op->type) {
+      case LOG_FORMAT_OP_LITERAL: {
+        res = buf_append(out, op->str, op->len);
+        break;
+      }
+      case LOG_FORMAT_OP_TIME: {
+        const log_time_cache_t* cache = get_time_cache(ts.tv_sec);
+        res = cache && buf_append(out, cache->str, cache->len);
+        break;
+      }
+      case LOG_FORMAT_OP_MSEC: {
+        res = buf_reserve(out, MSEC_DIGITS);
+        if (!res) { break; }
+        unsigned msec = (unsigned)(ts.tv_nsec / 1000000);
+        argfmt_put_digits(out->data + out->len, msec, MSEC_DIGITS);
+        out->len += MSEC_DIGITS;
+        break;
+      }
+      case LOG_FORMAT_OP_USEC: {
+        res = buf_reserve(out, USEC_DIGITS);
+        if (!res) { break; }
+        unsigned usec = (unsigned)(ts.tv_nsec / 1000);
+        argfmt_put_digits(out->data + out->len, usec, USEC_DIGITS);
+        out->len += USEC_DIGITS;
+        break;
+      }
+      case LOG_FORMAT_OP_LEVEL: {
+        // 5文字に満たない場合、空白で埋める（%-5s）
+        const char* level = get_level_name(site->level);
+        size_t len = strlen(level);
+        res = buf_append(out, level, len) &&
+              (len >= LEVEL_WIDTH ||
+               buf_append(out, "     ", LEVEL_WIDTH - len));
+        break;
+      }
+      case LOG_FORMAT_OP_FNAME: {
+        res = buf_append(out, site->fname, strlen(site->fname));
+        break;
+      }
+      case LOG_FORMAT_OP_LINE: {
+        res = buf_reserve(out, ARGFMT_DEC_SIZE);
+        if (!res) { break; }
+        out->len += argfmt_put_int(out->data + out->len, site->line);
+        break;
+      }
+      case LOG_FORMAT_OP_FUNC: {
+        res = buf_append(out, site->func, strlen(site->func));
+        break;
+      }
+      case LOG_FORMAT_OP_MSG: {
+        res = buf_append(out, msg, strlen(msg));
+        if (res && item->kv_len > 0) { res = write_fields(out, item); }
+        break;
+      }
+      case LOG_FORMAT_OP_TID:
+      case LOG_FORMAT_OP_PID: {
+        res = buf_reserve(out, ARGFMT_DEC_SIZE);
+        if (!res) { break; }
+        pid_t id = op->type == LOG_FORMAT_OP_TID ? item->tid : item->pid;
+        out->len += argfmt_put_int(out->data + out->len, id);
+        break;
+      }
+      case LOG_FORMAT_OP_SEQ:
+      case LOG_FORMAT_OP_MONO: {
+        res = buf_reserve(out, ARGFMT_DEC_SIZE);
+        if (!res) { break; }
+        uint64_t value =
+            op->type == LOG_FORMAT_OP_SEQ ? item->seq : item->mono_ns;
+        out->len += argfmt_put_uint(out->data + out->len, value);
+        break;
+      }
+    }
+    if (!res) {
+      out->len = start;
+      return false;
+    }
+  }
+
+  // 終端処理
+  if (out->len == start || out->data[out->len - 1] != '\n') {
+    if (!buf_append(out, "\n", 1)) {
+      out->len = start;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+/**
+ * @brief 構造化ログのフィールドの値を書き込む。
+ * @param out 出力待ちデータのバッファ。
+ * @param field フィールド。
+ * @param json JSON形式フラグ。（文字列をエスケープして引用符で囲む）
+ * @return 成功: true, 失敗: false。
+ */
+static bool write_field_value(
+    log_buf_t* out, const log_field_t* field, const bool json
+) {
+  const char* str = NULL;
+  switch (field->type) {
+    case LOG_FIELD_STR: {
+      str = field->value.s ? field->value.s : (json ? "null" : "(null)");
+      if (!json || !field->value.s) {
+        return buf_append(out, str, strlen(str));
+      }
+      return buf_append(out, "\"", 1) &&
+             json_write_str(out, str, strlen(str)) && buf_append(out, "\"", 1);
+    }
+    case LOG_FIELD_BOOL: {
+      str = field->value.b ? "true" : "false";
+      return buf_append(out, str, strlen(str));
+    }
+    case LOG_FIELD_DOUBLE: {
+      // JSONで表現できない値（無限大、NaN）はnullとする
+      if (json && !isfinite(field->value.d)) {
+        return buf_append(out, "null", 4);
+      }
+      break;
+    }
+    case LOG_FIELD_INT:
+    case LOG_FIELD_UINT:
+    default:
+      break;
+  }
+
+  if (!buf_reserve(out, MAX_CONV_SPEC_SIZE)) { return false; }
+  char* pos = out->data + out->len;
+  if (field->type == LOG_FIELD_INT) {
+    out->len += argfmt_put_int(pos, field->value.i);
+    return true;
+  }
+  if (field->type == LOG_FIELD_UINT) {
+    out->len += argfmt_put_uint(pos, field->value.u);
+    return true;
+  }
+
+  int n = snprintf(pos, MAX_CONV_SPEC_SIZE, "%.17g", field->value.d);
+  if (n < 0) { return false; }
+  out->len += (size_t)n;
+
+  return true;
+}
+
+/**
+ * @brief 構造化ログのフィールドをテキスト形式（ key=value）で書き込む。
+ * @param out 出力待ちデータのバッファ。
+ * @param item ログデータ。（フィールドを設定済みであること）
+ * @return 成功: true, 失敗: false。
+ */
+static bool write_fields(log_buf_t* out, const log_item_t* item) {
+  const char* data = item_get_fields(item);
+  const char* end = data + item->kv_len;
+  while (data < end) {
+    log_field_t field;
+    data = field_decode(data, &field);
+    if (!buf_append(out, " ", 1) ||
+        !buf_append(out, field.key, strlen(field.key)) ||
+        !buf_append(out, "=", 1) || !write_field_value(out, &field, false)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * @brief JSON文字列としてエスケープが必要なバイトを含むか判定する。
+ *
+ * - 8バイトを一度に判定する。（SWAR）
+ * - 制御文字(0x00-0x1f)、'"'、'\\'を含む場合、0以外を返す。
+ *   （0x80以上のバイトはUTF-8としてそのまま出力するため含まない）
+ * @param chunk 判定する8バイト。
+ * @return 含む: 0以外, 含まない: 0。
+ */
+static uint64_t json_needs_escape(const uint64_t chunk) {
+  const uint64_t ones = 0x0101010101010101u;
+  const uint64_t highs = 0x8080808080808080u;
+  uint64_t quote = chunk ^ (ones * '"');
+  uint64_t bslash = chunk ^ (ones * '\\');
+
+  // 0x20未満のバイト、'"'と一致するバイト、'\\'と一致するバイト
+  return (((chunk - ones * 0x20) & ~chunk) | ((quote - ones) & ~quote) |
+          ((bslash - ones) & ~bslash)) &
+         highs;
+}
+
+/**
+ * @brief 文字列をJSON文字列としてエスケープして書き込む。（引用符は含まない）
+ *
+ * - エスケープが不要な範囲は8バイト単位で読み飛ばし、まとめて書き込む。
+ * @param out 出力待ちデータのバッファ。
+ * @param str 文字列。
+ * @param len 文字列のバイト数。
+ * @return 成功: true, 失敗: false。
+ */
+static bool json_write_str(log_buf_t* out, const char* str, const size_t len) {
+  static const char hex[] = "0123456789abcdef";
+  if (!buf_reserve(out, len)) { return false; }
+
+  size_t pos = 0;  // 未書き込みの先頭
+  size_t i = 0;
+  while (i < len) {
+    // エスケープが不要な範囲を8バイト単位で読み飛ばし
+    uint64_t chunk;
+    while (i + sizeof(chunk) <= len) {
+      memcpy(&chunk, str + i, sizeof(chunk));
+      if (json_needs_escape(chunk)) { break; }
+      i += sizeof(chunk);
+    }
+
+    // エスケープが必要なバイトを含む範囲は1バイトずつ処理
+    size_t end = i + sizeof(chunk) < len ? i + sizeof(chunk) : len;
+    for (; i < end; i++) {
+      unsigned char ch = (unsigned char)str[i];
+      if (ch >= 0x20 && ch != '"' && ch != '\\') { continue; }
+
+      char esc[6] = {'\\', (char)ch, '0', '0', hex[ch >> 4], hex[ch & 0xf]};
+      size_t esc_len = 2;
+      switch (ch) {
+        case '\n':
+          esc[1] = 'n';
+          break;
+        case '\r':
+          esc[1] = 'r';
+          break;
+        case '\t':
+          esc[1] = 't';
+          break;
+        case '\b':
+          esc[1] = 'b';
+          break;
+        case '\f':
+          esc[1] = 'f';
+          break;
+        case '"':
+        case '\\':
+          break;
+        default:
+          esc[1] = 'u';
+          esc_len = sizeof(esc);
+          break;
+      }
+      if (!buf_append(out, str + pos, i - pos) ||
+          !buf_append(out, esc, esc_len)) {
+        return false;
+      }
+      pos = i + 1;
+    }
+  }
+
+  return buf_append(out, str + pos, len - pos);
+}
+
+/**
+ * @brief JSON形式のログのうち、呼び出し箇所ごとに固定の部分を書き込む。
+ *
+ * - ログレベル、ファイル名、行番号、関数名と、メッセージの開始までを
+ *   書き込む。
+ * @param out 出力待ちデータのバッファ。
+ * @param site 登録済みの呼び出し箇所データ。
+ * @return 成功: true, 失敗: false。
+ */
+static bool json_write_site(log_buf_t* out, const log_site_t* site) {
+  char line[MAX_CONV_SPEC_SIZE];
+  int n = snprintf(
+      line, sizeof(line), "\",\"line\":%d,\"func\":\"", site->line
+  );
+  if (n < 0) { return false; }
+
+  const char* level = get_level_name(site->level);
+  return buf_append(out, ",\"level\":\"", 10) &&
+         buf_append(out, level, strlen(level)) &&
+         buf_append(out, "\",\"file\":\"", 10) &&
+         json_write_str(out, site->fname, strlen(site->fname)) &&
+         buf_append(out, line, (size_t)n) &&
+         json_write_str(out, site->func, strlen(site->func)) &&
+         buf_append(out, "\",\"msg\":\"", 9);
+}
+
+/**
+ * @brief JSON形式のログのうち、呼び出し箇所ごとに固定の部分を作成する。
+ *
+ * - 呼び出し箇所の登録時に1回だけ作成し、ログごとの作成を省く。
+ * @param site 呼び出し箇所データ。（ファイル名と関数名を設定済みであること）
+ * @return 固定部分の文字列。（失敗: NULL）
+ */
+static char* json_build_site(const log_site_t* site) {
+  log_buf_t buf = {0};
+  if (!json_write_site(&buf, site) || !buf_append(&buf, "", 1)) {
+    buf_destroy(&buf);
+    return NULL;
+  }
+
+  return buf.data;
+}
+
+/**
+ * @brief ログデータをJSON Lines形式でシンクの出力待ちデータに書き込む。
+ *
+ * - 時刻、ログレベル、ファイル名、行番号、関数名、メッセージと、
+ *   構造化ログのフィールドを1行のJSONオブジェクトとして書き込む。
+ * - 失敗した場合、バッファを元の状態に戻す。
+ * @param out 出力待ちデータのバッファ。
+ * @param item ログデータ。
+ * @param msg メッセージ。（item_renderで取得したもの）
+ * @return 成功: true, 失敗: false。
+ */
+static bool output_json(
+    log_buf_t* out, const log_item_t* item, const char* msg
+) {
+  const log_site_t* site = item->site;
+  size_t start = out->len;
+
+  // 時刻（マイクロ秒まで）
+  const log_time_cache_t* cache = get_time_cache(item->ts.tv_sec);
+  bool res = cache && buf_append(out, "{\"time\":\"", 9) &&
+             buf_append(out, cache->str, cache->len) &&
+             buf_reserve(out, 1 + USEC_DIGITS);
+  if (res) {
+    out->data[out->len++] = '.';
+    unsigned usec = (unsigned)(item->ts.tv_nsec / 1000);
+    argfmt_put_digits(out->data + out->len, usec, USEC_DIGITS);
+    out->len += USEC_DIGITS;
+  }
+
+  // 呼び出し箇所ごとの固定部分とメッセージ
+  res = res && buf_append(out, "\"", 1) &&
+        (site->json ? buf_append(out, site->json, strlen(site->json))
+                    : json_write_site(out, site)) &&
+        json_write_str(out, msg, strlen(msg)) && buf_append(out, "\"", 1);
+
+  // フィールド（キーの接頭辞はコンパイル時に作成済み）
+  if (res && item->kv_len > 0) {
+    const char* data = item_get_fields(item);
+    const char* end = data + item->kv_len;
+    while (res && data < end) {
+      log_field_t field;
+      data = field_decode(data, &field);
+      res = buf_append(out, field.json_key, strlen(field.json_key)) &&
+            write_field_value(out, &field, true);
+    }
+  }
+
+  res = res && buf_append(out, "}\n", 2);
+  if (!res) { out->len = start; }
+
+  return res;
+}
+
+/**
+ * @brief 現在時刻をナノ秒で取得する。
+ * @return 現在時刻[ns]。（UNIX時間）
+ */
+static uint64_t get_realtime_ns(void) {
+  struct timespec ts;
+  if (timespec_get(&ts, TIME_UTC) != TIME_UTC) { return 0; }
+
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief 単調増加時刻をナノ秒で取得する。
+ * @return 単調増加時刻[ns]。
+ */
+static uint64_t get_monotonic_ns(void) {
+  struct timespec ts;
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) { return 0; }
+
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief TSCの1カウントあたりの時間を、単調増加時刻と比較して較正する。
+ *
+ * - 周波数が一定の不変TSCの場合のみ使用可能とする。
+ */
+static void tsc_calibrate(void) {
+#ifdef LOG_HAS_TSC
+  // CPUID 0x80000007 EDX bit 8: 不変TSC
+  unsigned eax = 0, ebx = 0, ecx = 0, edx = 0;
+  if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) ||
+      !(edx & (1u << 8))) {
+    return;
+  }
+
+  uint64_t ns0 = get_monotonic_ns();
+  uint64_t tsc0 = __rdtsc();
+  struct timespec wait = {.tv_sec = 0, .tv_nsec = TSC_CALIBRATE_NS};
+  while (nanosleep(&wait, &wait) != 0 && errno == EINTR) {}
+  uint64_t ns1 = get_monotonic_ns();
+  uint64_t tsc1 = __rdtsc();
+  if (ns1 <= ns0 || tsc1 <= tsc0) { return; }
+
+  g_tsc.ns_per_tick = (double)(ns1 - ns0) / (double)(tsc1 - tsc0);
+  g_tsc.anchor_ticks = (uint64_t)(TSC_ANCHOR_NS / g_tsc.ns_per_tick);
+  g_tsc.valid = true;
+#endif
+}
+
+/**
+ * @brief TSCから単調増加時刻をナノ秒で取得する。
+ *
+ * - スレッドごとに基準時刻を持ち、一定間隔で単調増加時刻を取り直して
+ *   較正の誤差が蓄積しないようにする。（スレッド内では単調増加を保つ）
+ * - TSCを使用できない場合、単調増加時刻をそのまま返す。
+ * @return 単調増加時刻[ns]。
+ */
+static uint64_t get_tsc_ns(void) {
+#ifdef LOG_HAS_TSC
+  if (g_tsc.valid) {
+    log_tls_t* tls = &g_tls;
+    uint64_t tsc = __rdtsc();
+    uint64_t ticks = tsc - tls->tsc_base;
+    uint64_t ns = 0;
+    if (tls->tsc_base != 0 && ticks < g_tsc.anchor_ticks) {
+      ns = tls->tsc_base_ns + (uint64_t)((double)ticks * g_tsc.ns_per_tick);
+    } else {
+      tls->tsc_base = tsc;
+      tls->tsc_base_ns = get_monotonic_ns();
+      ns = tls->tsc_base_ns;
+    }
+    if (ns < tls->mono_last) { ns = tls->mono_last; }
+    tls->mono_last = ns;
+    return ns;
+  }
+#endif
+
+  return get_monotonic_ns();
+}
+
+/**
+ * @brief 呼び出し元スレッドのIDを取得する。
+ *
+ * - LinuxではカーネルのスレッドID（gettid）とする。それ以外では
+ *   プロセス内の通し番号とする。
+ * @return スレッドID。
+ */
+static pid_t get_thread_id(void) {
+#ifdef SYS_gettid
+  return (pid_t)syscall(SYS_gettid);
+#else
+  static atomic_int next = 0;
+  return (pid_t)(atomic_fetch_add_explicit(&next, 1, memory_order_relaxed) + 1);
+#endif
+}
+
+/**
+ * @brief 整数を可変長整数(LEB128形式)に変換する。
+ * @param out 出力先。（BIN_VARINT_MAXバイト以上あること）
+ * @param value 整数。
+ * @return 変換後のバイト数。
+ */
+static size_t bin_encode_varint(unsigned char* out, uint64_t value) {
+  size_t len = 0;
+  while (value >= 0x80) {
+    out[len++] = (unsigned char)(value | 0x80);
+    value >>= 7;
+  }
+  out[len++] = (unsigned char)value;
+
+  return len;
+}
+
+/**
+ * @brief 文字列をバイト数(varint) + 本体の形式で書き込む。
+ * @param out 出力待ちデータのバッファ。
+ * @param str 文字列。
+ * @return 成功: true, 失敗: false。
+ */
+static bool bin_write_str(log_buf_t* out, const char* str) {
+  unsigned char buf[BIN_VARINT_MAX];
+  size_t len = str ? strlen(str) : 0;
+  size_t n = bin_encode_varint(buf, len);
+
+  return buf_append(out, buf, n) && buf_append(out, str, len);
+}
+
+/**
+ * @brief バイナリ形式のヘッダを書き込む。
+ * @param out 出力待ちデータのバッファ。
+ * @param base_ns 基準時刻[ns]。（直後のレコードの時刻差分の基準）
+ * @return 成功: true, 失敗: false。
+ */
+static bool bin_write_header(log_buf_t* out, const uint64_t base_ns) {
+  if (!out) {
+    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
+    return false;
+  }
+
+  unsigned char buf[LOGBIN_MAGIC_LEN + 1 + BIN_VARINT_MAX * 2 + 3];
+  size_t len = 0;
+  memcpy(buf, LOGBIN_MAGIC, LOGBIN_MAGIC_LEN);
+  len += LOGBIN_MAGIC_LEN;
+  buf[len++] = LOGBIN_VERSION;
+
+  len += bin_encode_varint(buf + len, base_ns / 1000000000u);
+  len += bin_encode_varint(buf + len, base_ns % 1000000000u);
+  buf[len++] = (unsigned char)sizeof(long);
+  buf[len++] = (unsigned char)sizeof(void*);
+  buf[len++] = (unsigned char)sizeof(long double);
+
+  return buf_append(out, buf, len);
+}
+
+/**
+ * @brief 呼び出し箇所を書き込み、書き込み済みとして記録する。
+ * @param sink シンク。
+ * @param out 出力待ちデータのバッファ。
+ * @param site 呼び出し箇所データ。
+ * @return 成功: true, 失敗: false。
+ */
+static bool bin_write_site(
+    log_sink_t* sink, log_buf_t* out, const log_site_t* site
+) {
+  if (!sink || !out || !site) {
+    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
+    return false;
+  }
+
+  // 書き込み済みフラグを拡張
+  if (site->id >= sink->bin_nsites) {
+    size_t new_n = sink->bin_nsites ? sink->bin_nsites : INI_BIN_SITE_NUM;
+    while (new_n <= site->id) { new_n *= 2; }
+    unsigned char* new_sites = realloc(sink->bin_sites, new_n);
+    if (!new_sites) {
+      SET_ERR_LOG_AUTO(ERR_MEM_ALLOC_FAILED);
+      return false;
+    }
+    memset(new_sites + sink->bin_nsites, 0, new_n - sink->bin_nsites);
+    sink->bin_sites = new_sites;
+    sink->bin_nsites = new_n;
+  }
+
+  unsigned char buf[1 + BIN_VARINT_MAX * 3];
+  size_t len = 0;
+  buf[len++] = LOGBIN_TAG_SITE;
+  len += bin_encode_varint(buf + len, site->id);
+  len += bin_encode_varint(buf + len, (uint64_t)site->level);
+  len += bin_encode_varint(buf + len, (uint64_t)site->line);
+  if (!buf_append(out, buf, len) || !bin_write_str(out, site->fname) ||
+      !bin_write_str(out, site->func) || !bin_write_str(out, site->fmt)) {
+    return false;
+  }
+  sink->bin_sites[site->id] = 1;
+
+  return true;
+}
+
+/**
+ * @brief 登録済みのすべての呼び出し箇所を書き込む。
+ * @param sink シンク。
+ * @param out 出力待ちデータのバッファ。
+ * @return 成功: true, 失敗: false。
+ */
+static bool bin_write_sites(log_sink_t* sink, log_buf_t* out) {
+  const log_site_t* site = atomic_load_explicit(&g_sites, memory_order_acquire);
+  for (; site; site = site->next) {
+    if (!bin_write_site(sink, out, site)) { return false; }
+  }
+
+  return true;
+}
+
+/**
+ * @brief ログデータをバイナリ形式でシンクの出力待ちデータに書き込む。
+ *
+ * - 遅延フォーマットの場合は引数の生のバイト列を、
+ *   それ以外の場合はフォーマット済みのメッセージを書き込む。
+ * - 構造化ログの場合、フィールドをテキスト形式で付けたメッセージを書き込む。
+ * @param sink シンク。
+ * @param item ログデータ。
+ * @return 成功: true, 失敗: false。
+ */
+static bool output_binary(log_sink_t* sink, const log_item_t* item) {
+  if (!sink || !item) {
+    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
+    return false;
+  }
+
+  // 未出力の呼び出し箇所を書き込み
+  log_buf_t* out = &sink->buf;
+  const log_site_t* site = item->site;
+  if (site->id >= sink->bin_nsites || !sink->bin_sites[site->id]) {
+    if (!bin_write_site(sink, out, site)) { return false; }
+  }
+
+  // 直前のレコードとの時刻差分
+  uint64_t now = (uint64_t)item->ts.tv_sec * 1000000000u +
+                 (uint64_t)item->ts.tv_nsec;
+  uint64_t delta = now > sink->bin_last_ns ? now - sink->bin_last_ns : 0;
+  if (now > sink->bin_last_ns) { sink->bin_last_ns = now; }
+
+  unsigned char buf[1 + BIN_VARINT_MAX * 3];
+  size_t len = 0;
+  buf[len++] = item->deferred ? LOGBIN_TAG_ARGS : LOGBIN_TAG_MSG;
+  len += bin_encode_varint(buf + len, site->id);
+  len += bin_encode_varint(buf + len, delta);
+
+  if (item->kv_len == 0) {
+    size_t size;
+    const char* data = item_get_data(item, &size);
+    len += bin_encode_varint(buf + len, size);
+    return buf_append(out, buf, len) && buf_append(out, data, size);
+  }
+
+  // 構造化ログの場合、フィールドをテキスト形式で付けたメッセージを末尾に
+  // 作成してから、その前にレコードの先頭を挿入
+  size_t start = out->len;
+  if (!buf_append(out, item->msg, strlen(item->msg)) ||
+      !write_fields(out, item)) {
+    out->len = start;
+    return false;
+  }
+  size_t size = out->len - start;
+  len += bin_encode_varint(buf + len, size);
+  if (!buf_reserve(out, len)) {
+    out->len = start;
+    return false;
+  }
+  memmove(out->data + start + len, out->data + start, size);
+  memcpy(out->data + start, buf, len);
+  out->len += len;
+
+  return true;
+}
+
+/**
+ * @brief シンクを初期化する。
+ *
+ * - ファイルの場合、ファイルを開き、バイナリ形式であればヘッダと登録済みの
+ *   呼び出し箇所を書き込む。
+ * - 最大ファイルサイズを指定した場合、シンクに書き込むスレッドが
+ *   書き込み時にローテーションする。（rotator.h参照）
+ * - 専用スレッドはキューの作成のみ行い、sink_startで起動する。
+ * @param self シンク。（ゼロ初期化済みであること）
+ * @param config シンクの設定。
+ * @return 成功: true, 失敗: false。
+ */
+static bool sink_init(log_sink_t* self, const logger_sink_config_t* config) {
+  if (!self || !config) {
+    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
+    return false;
+  }
+
+  self->type = config->type;
+  self->level = config->level;
+  self->json = config->json && !config->binary;
+  self->format = format_init(config->fmt ? config->fmt : DEFAULT_FORMAT);
+  if (!self->format) { return false; }
+  for (size_t i = 0; i < LOG_LEVEL_NUM; i++) {
+    atomic_init(&self->dropped[i], 0);
+  }
+  atomic_init(&self->sleeping, false);
+  atomic_init(&self->crash_parked, false);
+  atomic_init(&self->dump, false);
+  atomic_init(&self->flush_req, 0);
+  self->flushed_ns = get_monotonic_ns();
+  atomic_init(&self->fd, self->type == LOG_SINK_STDOUT ? STDOUT_FILENO : -1);
+
+  if (self->type == LOG_SINK_FILE) {
+    if (!config->fpath) {
+      SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
+      return false;
+    }
+    if (config->max_fsize > 0) {
+      self->rotator = rotator_init_fpath(
+          config->fpath, config->max_fsize, config->max_fno
+      );
+      if (!self->rotator) { return false; }
+    } else {
+      self->fp = fp_init(config->fpath);
+      if (!self->fp) { return false; }
+    }
+    atomic_store(
+        &self->fd,
+        self->rotator ? rotator_fileno(self->rotator) : fileno(self->fp)
+    );
+
+    // バイナリ形式の場合、ヘッダと登録済みの呼び出し箇所を書き込み
+    self->binary = config->binary;
+    if (self->binary) {
+      uint64_t now = get_realtime_ns();
+      if (!bin_write_header(&self->buf, now)) { return false; }
+      if (!bin_write_sites(self, &self->buf)) { return false; }
+      self->bin_last_ns = now;
+      self->bin_flushed_ns = now;
+    }
+  }
+
+  // フライトレコーダ（バイナリ形式では無効）
+  if (config->recorder > 0 && !self->binary) {
+    if (!recorder_init(&self->recorder, config->recorder)) { return false; }
+  }
+
+  self->thread = config->thread;
+  if (self->thread) {
+    size_t nqueue = config->nqueue > 0 ? config->nqueue : MAX_SINK_QUEUE_NO;
+    self->queue = queue_init(nqueue);
+    if (!self->queue) { return false; }
+  }
+
+  return true;
+}
+
+/**
+ * @brief シンクを解放する。
+ *
+ * - 専用スレッドはsink_stopで停止しておくこと。
+ * @param self シンク。
+ */
+static void sink_destroy(log_sink_t* self) {
+  if (!self) { return; }
+
+  buf_destroy(&self->buf);
+  recorder_destroy(&self->recorder);
+  fp_destroy(&self->fp);
+  rotator_close(&self->rotator);
+  format_destroy(&self->format);
+  queue_destroy(&self->queue);
+  if (self->bin_sites) { free(self->bin_sites); }
+  self->bin_sites = NULL;
+  self->bin_nsites = 0;
+  if (self->msg) { free(self->msg); }
+  self->msg = NULL;
+  self->msg_cap = 0;
+}
+
+/**
+ * @brief ログをシンクの出力待ちデータのバッファに書き込む。
+ * @param self シンク。
+ * @param item ログデータ。
+ * @param msg メッセージ。（バイナリ形式の場合、使用しない）
+ * @return 成功: true, 失敗: false。
+ */
+static bool sink_write(
+    log_sink_t* self, const log_item_t* item, const char* msg
+) {
+  if (self->binary) { return output_binary(self, item); }
+  if (!msg) { return false; }
+  if (self->json) { return output_json(&self->buf, item, msg); }
+
+  return format_line(self->format, item, msg, &self->buf);
+}
+
+/**
+ * @brief ファイルの出力待ちデータをローテーションしながら書き込む。
+ *
+ * - ローテーションの判定はフォーマット済みの出力待ちデータ全体で行い、
+ *   出力待ちデータは分割せずに1つのファイルに書き込む。
+ * - バイナリ形式でローテーションする場合、新しいファイルの先頭に
+ *   ヘッダと登録済みの呼び出し箇所を書き込む。（基準時刻は前のファイルの
+ *   最後のレコードの時刻とし、出力待ちデータの時刻差分をそのまま使う）
+ * @param self シンク。
+ * @return 成功: true, 失敗: false。
+ */
+static bool write_rotator(log_sink_t* self) {
+  log_buf_t* buf = &self->buf;
+  if (!self->binary || !rotator_is_full(self->rotator, buf->len)) {
+    return rotator_write(self->rotator, buf->data, buf->len);
+  }
+
+  log_buf_t data = {0};
+  bool res = bin_write_header(&data, self->bin_flushed_ns) &&
+             bin_write_sites(self, &data) &&
+             buf_append(&data, buf->data, buf->len) &&
+             rotator_write(self->rotator, data.data, data.len);
+  buf_destroy(&data);
+
+  return res;
+}
+
+/**
+ * @brief シンクの出力待ちデータを書き込む。
+ *
+ * - 標準出力は1回のfwriteで、ファイルは1回のwriteでまとめて書き込む。
+ * - フライトレコーダの場合、書き込み要求があるまでは書き込まずに
+ *   フライトレコーダに移し、要求があればフライトレコーダのログから続けて
+ *   書き込む。
+ * @param self シンク。
+ */
+static void sink_flush(log_sink_t* self) {
+  log_buf_t* buf = &self->buf;
+  if (self->recorder.cap > 0) {
+    if (!atomic_exchange_explicit(&self->dump, false, memory_order_relaxed)) {
+      recorder_append(&self->recorder, buf->data, buf->len);
+      buf->len = 0;
+      self->flushed_ns = get_monotonic_ns();
+      return;
+    }
+    recorder_take(&self->recorder, buf);
+  }
+  if (buf->len > 0) {
+    if (self->type == LOG_SINK_STDOUT) {
+      if (fwrite(buf->data, 1, buf->len, stdout) != buf->len) {
+        SET_ERR_LOG_AUTO(ERR_IO_ERROR);
+      }
+      fflush(stdout);
+    } else if (self->rotator) {
+      write_rotator(self);
+      // ローテーションで切り替わったファイルに追従
+      atomic_store_explicit(
+          &self->fd, rotator_fileno(self->rotator), memory_order_relaxed
+      );
+    } else if (self->fp) {
+      write_fd(fileno(self->fp), buf->data, buf->len);
+    }
+  }
+  buf->len = 0;
+  self->bin_flushed_ns = self->bin_last_ns;
+  self->flushed_ns = get_monotonic_ns();
+}
+
+/**
+ * @brief フラッシュポリシーに従い、シンクの出力待ちデータを書き込む。
+ *
+ * 以下のいずれかを満たす場合に書き込む。（標準出力は常に書き込む）
+ * - ログレベルが即時フラッシュするログレベル以上
+ * - 出力待ちデータのバイト数が閾値以上
+ * - 最後のフラッシュからフラッシュ間隔以上経過
+ * - フライトレコーダの書き込み要求あり（ERRORを出力した場合も要求する）
+ * @param self シンク。
+ * @param level 出力したログの最大レベル。
+ */
+static void sink_flush_by_policy(log_sink_t* self, const log_level_t level) {
+  if (self->buf.len == 0) { return; }
+
+  if (self->recorder.cap > 0 && level >= LOG_LEVEL_ERROR) {
+    atomic_store_explicit(&self->dump, true, memory_order_relaxed);
+  }
+  if (self->type == LOG_SINK_STDOUT || level >= self->logger->flush_level ||
+      self->buf.len >= self->logger->flush_bytes ||
+      atomic_load_explicit(&self->dump, memory_order_relaxed)) {
+    sink_flush(self);
+    return;
+  }
+  sink_flush_by_interval(self);
+}
+
+/**
+ * @brief 最後のフラッシュからフラッシュ間隔以上経過した場合、
+ *        シンクの出力待ちデータを書き込む。
+ * @param self シンク。
+ */
+static void sink_flush_by_interval(log_sink_t* self) {
+  if (get_flush_wait_ns(self) == 0) { sink_flush(self); }
+}
+
+/**
+ * @brief 次のフラッシュまでの時間を取得する。
+ * @param self シンク。
+ * @return 次のフラッシュまでの時間[ns]。（経過済み: 0, 不要: UINT64_MAX）
+ */
+static uint64_t get_flush_wait_ns(const log_sink_t* self) {
+  uint64_t flush_ns = self->logger->flush_ns;
+  if (self->buf.len == 0 || flush_ns == 0) { return UINT64_MAX; }
+
+  uint64_t elapsed = get_monotonic_ns() - self->flushed_ns;
+
+  return elapsed >= flush_ns ? 0 : flush_ns - elapsed;
+}
+
+/**
+ * @brief 前回の通知以降に破棄したログの数をシンクに出力する。
+ *
+ * - キューが満杯で破棄したログと、シンクの専用スレッドのキューが満杯で
+ *   破棄したログを合わせて数える。（シンクのログレベル未満は数えない）
+ * - 破棄がない場合、何もしない。
+ * - シンクに書き込むスレッドから呼び出すこと。
+ * @param self シンク。
+ */
+static void sink_output_dropped(log_sink_t* self) {
+  size_t delta[LOG_LEVEL_NUM] = {0};
+  size_t total = 0;
+  for (size_t i = (size_t)self->level; i < LOG_LEVEL_NUM; i++) {
+    size_t n =
+        atomic_load_explicit(&self->logger->dropped[i], memory_order_relaxed) +
+        atomic_load_explicit(&self->dropped[i], memory_order_relaxed);
+    delta[i] = n - self->reported[i];
+    self->reported[i] = n;
+    total += delta[i];
+  }
+  if (total == 0) { return; }
+
+  static log_site_t site = {
+      .fpath = __FILE__,
+      .func = __func__,
+      .line = __LINE__,
+      .level = LOG_LEVEL_WARN,
+      .fmt = "%zu messages dropped",
+  };
+  log_item_t item = {.site = site_register(&site)};
+  item.msg = item.buf;
+  item_stamp(self->logger, &item);
+  snprintf(
+      item.buf, sizeof(item.buf),
+      "%zu messages dropped (DEBUG: %zu, INFO: %zu, WARN: %zu, ERROR: %zu)",
+      total, delta[LOG_LEVEL_DEBUG], delta[LOG_LEVEL_INFO],
+      delta[LOG_LEVEL_WARN], delta[LOG_LEVEL_ERROR]
+  );
+
+  sink_write(self, &item, item.msg);
+  sink_flush_by_policy(self, LOG_LEVEL_WARN);
+}
+
+/**
+ * @brief 専用スレッドのシンクのキューにログデータを参照で追加する。
+ *
+ * - キューが満杯の場合、このシンクでのみ破棄する。（他のシンクは待たない）
+ * @param self シンク。
+ * @param item ログデータ。（呼び出し元が参照を保持していること）
+ */
+static void sink_enqueue(log_sink_t* self, log_item_t* item) {
+  atomic_fetch_add_explicit(&item->refs, 1, memory_order_relaxed);
+  if (ring_push(self->queue, item)) { return; }
+
+  atomic_fetch_sub_explicit(&item->refs, 1, memory_order_relaxed);
+  log_level_t level = item->site->level;
+  if ((unsigned)level < LOG_LEVEL_NUM) {
+    atomic_fetch_add_explicit(&self->dropped[level], 1, memory_order_relaxed);
+  }
+}
+
+/**
+ * @brief 複数のログデータをシンクに出力する。（専用スレッド用）
+ *
+ * - 出力したログデータの参照を解放する。
+ * @param self シンク。
+ * @param items ログデータの配列。
+ * @param nitem ログデータの数。
+ */
+static void sink_output_items(
+    log_sink_t* self, log_item_t** items, const size_t nitem
+) {
+  log_level_t level = LOG_LEVEL_DEBUG;
+  for (size_t i = 0; i < nitem; i++) {
+    log_item_t* item = items[i];
+    if (item->site->level > level) { level = item->site->level; }
+    const char* msg =
+        self->binary ? NULL : item_render(item, &self->msg, &self->msg_cap);
+    sink_write(self, item, msg);
+    item_unref(item);
+    if (self->buf.len >= self->logger->flush_bytes) { sink_flush(self); }
+  }
+
+  sink_flush_by_policy(self, level);
+}
+
+/**
+ * @brief logger_flushの要求を完了させる。（専用スレッド用）
+ *
+ * - 要求時点でワーカーから渡されたログをすべて出力していれば、
+ *   シンクをフラッシュして要求元に通知する。
+ * @param self シンク。
+ */
+static void sink_complete_flush(log_sink_t* self) {
+  uint64_t req = atomic_load_explicit(&self->flush_req, memory_order_acquire);
+  if (req == self->flush_done || !ring_is_empty(self->queue)) { return; }
+
+  sink_flush(self);
+  if (!mutex_lock(&self->logger->mutex)) { return; }
+  self->flush_done = req;
+  pthread_cond_broadcast(&self->logger->flush_cond);
+  mutex_unlock(&self->logger->mutex);
+}
+
+/**
+ * @brief 待機中のシンクの専用スレッドを起床させる。
+ *
+ * - 専用スレッドが動作中の場合、mutexを取らずに戻る。
+ * @param self シンク。
+ * @return 成功: true, 失敗: false。
+ */
+static bool wake_sink(log_sink_t* self) {
+  // キューへの格納と待機中フラグの読み出しの順序を保証
+  atomic_thread_fence(memory_order_seq_cst);
+  if (!atomic_load_explicit(&self->sleeping, memory_order_relaxed)) {
+    return true;
+  }
+
+  if (!mutex_lock(&self->mutex)) { return false; }
+  bool res = cond_signal(&self->cond);
+  if (!mutex_unlock(&self->mutex)) { return false; }
+
+  return res;
+}
+
+/**
+ * @brief キューにログデータが追加されるまでシンクの専用スレッドを待機させる。
+ *
+ * - 未フラッシュのデータがある場合、次のフラッシュ時刻まで待機する。
+ * - logger_flushの要求があった場合、待機しない。
+ * @param self シンク。
+ * @return 継続: true, 終了: false。
+ */
+static bool park_sink(log_sink_t* self) {
+  if (!mutex_lock(&self->mutex)) { return false; }
+
+  // 待機中フラグの書き込みとキューの読み出しの順序を保証
+  atomic_store_explicit(&self->sleeping, true, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+  while (self->worker_running && ring_is_empty(self->queue) &&
+         atomic_load_explicit(&self->flush_req, memory_order_relaxed) ==
+             self->flush_done) {
+    uint64_t wait_ns = get_flush_wait_ns(self);
+    bool res = true;
+    bool timeout = false;
+    if (wait_ns == UINT64_MAX) {
+      res = cond_wait(&self->cond, &self->mutex);
+    } else if (wait_ns > 0) {
+      res = cond_timedwait(&self->cond, &self->mutex, wait_ns, &timeout);
+    } else {
+      timeout = true;
+    }
+    if (!res) {
+      mutex_unlock(&self->mutex);
+      return false;
+    }
+    // フラッシュ時刻になった場合、待機を中断
+    if (timeout) { break; }
+  }
+  atomic_store_explicit(&self->sleeping, false, memory_order_relaxed);
+
+  bool running = self->worker_running || !ring_is_empty(self->queue);
+  if (!mutex_unlock(&self->mutex)) { return false; }
+
+  return running;
+}
+
+/**
+ * @brief ワーカーから渡されたログデータをシンクへ出力する。（専用スレッド）
+ * @param arg シンク。
+ * @return NULL
+ */
+static void* sink_worker(void* arg) {
+  log_sink_t* self = (log_sink_t*)arg;
+
+  log_item_t* items[WORKER_BATCH_NUM];
+  size_t nline = 0;
+  while (true) {
+    // クラッシュ時は停止（シグナルハンドラが出力待ちデータを書き込む）
+    crash_park(&self->crash_parked);
+    // キューからログデータをまとめて取得してシンクに出力
+    size_t nitem = 0;
+    while (nitem < WORKER_BATCH_NUM &&
+           (items[nitem] = (log_item_t*)ring_pop(self->queue))) {
+      nitem++;
+    }
+    if (nitem > 0) {
+      sink_output_items(self, items, nitem);
+      // 破棄したログの数を一定行数ごとに出力
+      nline += nitem;
+      if (nline >= DROPPED_REPORT_INTERVAL) {
+        sink_output_dropped(self);
+        nline = 0;
+      }
+      // logger_flushの要求を完了
+      sink_complete_flush(self);
+      continue;
+    }
+
+    // 破棄したログの数を出力
+    sink_output_dropped(self);
+    // logger_flushの要求を完了
+    sink_complete_flush(self);
+
+    // キューが空の場合、ログデータ追加待ち（終了時は無限ループを終了）
+    if (!park_sink(self)) { break; }
+    crash_park(&self->crash_parked);
+    // フラッシュ間隔が経過した場合、フラッシュ
+    sink_flush_by_interval(self);
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief シンクの専用スレッドを起動する。
+ * @param self シンク。
+ * @return 成功: true, 失敗: false。
+ */
+static bool sink_start(log_sink_t* self) {
+  if (!self->thread) { return true; }
+
+  if (pthread_mutex_init(&self->mutex, NULL) != 0) {
+    SET_ERR_LOG_AUTO(ERR_MUTEX_INIT_FAILED);
+    return false;
+  }
+  if (pthread_cond_init(&self->cond, NULL) != 0) {
+    SET_ERR_LOG_AUTO(ERR_CONDITION_INIT_FAILED);
+    return false;
+  }
+  self->worker_running = true;
+  if (pthread_create(&self->worker, NULL, sink_worker, self) != 0) {
+    self->worker_running = false;
+    SET_ERR_LOG_AUTO(ERR_THREAD_CREATE_FAILED);
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * @brief シンクの専用スレッドを停止する。
+ *
+ * - キューに残ったログデータを出力してから停止する。
+ * @param self シンク。
+ */
+static void sink_stop(log_sink_t* self) {
+  if (!self->thread || !self->worker_running) { return; }
+
+  if (!mutex_lock(&self->mutex)) { return; }
+  self->worker_running = false;
+  cond_signal(&self->cond);
+  if (!mutex_unlock(&self->mutex)) { return; }
+  pthread_join(self->worker, NULL);
+
+  pthread_mutex_destroy(&self->mutex);
+  pthread_cond_destroy(&self->cond);
+}
+
+/**
+ * @brief 呼び出し元のスレッドが書き込むシンクの出力待ちデータを書き込む。
+ *
+ * - 専用スレッドが動作中のシンクは対象外とする。
+ */
+static void flush_sinks(logger_t* logger) {
+  for (size_t i = 0; i < logger->nsink; i++) {
+    if (!logger->sinks[i].worker_running) { sink_flush(&logger->sinks[i]); }
+  }
+}
+
+/**
+ * @brief フラッシュポリシーに従い、呼び出し元のスレッドが書き込む
+ *        シンクの出力待ちデータを書き込む。
+ * @param level 出力したログの最大レベル。
+ */
+static void flush_sinks_by_policy(logger_t* logger, const log_level_t level) {
+  for (size_t i = 0; i < logger->nsink; i++) {
+    if (!logger->sinks[i].worker_running) {
+      sink_flush_by_policy(&logger->sinks[i], level);
+    }
+  }
+}
+
+/**
+ * @brief logger_flushの要求が完了したか確認する。
+ *
+ * - logger->mutexをロックして呼び出すこと。
+ * @param req 要求番号。
+ * @return 完了: true, 未完了: false。
+ */
+static bool flush_completed(const logger_t* logger, const uint64_t req) {
+  if (logger->flush_done < req) { return false; }
+  for (size_t i = 0; i < logger->nsink; i++) {
+    const log_sink_t* sink = &logger->sinks[i];
+    if (sink->worker_running && sink->flush_done < req) { return false; }
+  }
+
+  return true;
+}
+
+/**
+ * @brief logger_flushの要求を完了させる。（ワーカー用）
+ *
+ * - 要求時点でキューに格納済みのログをすべて出力していれば、
+ *   ワーカーが書き込むシンクをフラッシュして要求元に通知する。
+ * - 専用スレッドのシンクには要求を引き継ぎ、各スレッドが完了を通知する。
+ */
+static void complete_flush_request(logger_t* logger) {
+  if (!atomic_load_explicit(&logger->flush_pending, memory_order_acquire)) {
+    return;
+  }
+
+  // 保留中の重複ログを出力
+  flush_repeat(logger, true);
+
+  if (!mutex_lock(&logger->mutex)) { return; }
+  bool done = ring_head(logger->lane.queue) >= logger->flush_pos;
+  if (logger->priority) {
+    done = done && ring_head(logger->err_lane.queue) >= logger->flush_err_pos;
+  }
+  if (done) {
+    flush_sinks(logger);
+    logger->flush_done = logger->flush_req;
+    for (size_t i = 0; i < logger->nsink; i++) {
+      atomic_store_explicit(
+          &logger->sinks[i].flush_req, logger->flush_req, memory_order_release
+      );
+    }
+    atomic_store_explicit(&logger->flush_pending, false, memory_order_release);
+    pthread_cond_broadcast(&logger->flush_cond);
+  }
+  mutex_unlock(&logger->mutex);
+
+  if (!done) { return; }
+  for (size_t i = 0; i < logger->nsink; i++) {
+    if (logger->sinks[i].worker_running) { wake_sink(&logger->sinks[i]); }
+  }
+}
+
+/**
+ * @brief ログデータを各シンクに出力する。
+ *
+ * - 専用スレッドを使用しないシンクには出力待ちデータのバッファに書き込み、
+ *   使用するシンクにはログデータを参照で渡す。
+ * - 遅延フォーマットのメッセージは、テキスト形式のシンクに書き込む場合のみ
+ *   1回だけ作成する。
+ * - 書き込み後、flush_sinks_by_policyで出力すること。
+ * @param item ログデータ。（呼び出し元が参照を保持していること）
+ * @param pmsg メッセージバッファ。
+ * @param pmsg_cap メッセージバッファサイズ。
+ */
+static void output_line(
+    logger_t* logger, log_item_t* item, char** pmsg, size_t* pmsg_cap
+) {
+  if (!item || !pmsg || !pmsg_cap) {
+    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
+    return;
+  }
+
+  const char* msg = NULL;
+  bool rendered = false;
+  for (size_t i = 0; i < logger->nsink; i++) {
+    log_sink_t* sink = &logger->sinks[i];
+    if (item->site->level < sink->level) { continue; }
+    if (sink->worker_running) {
+      sink_enqueue(sink, item);
+      continue;
+    }
+    if (!sink->binary && !rendered) {
+      msg = item_render(item, pmsg, pmsg_cap);
+      rendered = true;
+    }
+    sink_write(sink, item, msg);
+  }
+}
+
+/**
+ * @brief ログデータを各シンクに出力する。（同期モードの直接書き込み用）
+ *
+ * - 直接書き込むシンクには、呼び出し元スレッドのバッファに1行を作成し、
+ *   1回のwriteで書き込む。（追記モードのfdのため、行は混ざらない）
+ *   mutexとstdioのロックを取らないため、スレッド間で待ち合わせない。
+ * - それ以外のシンク（ローテーション、バイナリ形式、フライトレコーダ）は
+ *   状態を持つため、mutexを取って出力待ちデータのバッファに書き込む。
+ * @param item ログデータ。
+ */
+static void output_direct(logger_t* logger, log_item_t* item) {
+  // 同期モードは遅延フォーマットしない
+  const char* msg = item->msg ? item->msg : "";
+  const log_level_t level = item->site->level;
+  bool locked = false;
+  for (size_t i = 0; i < logger->nsink; i++) {
+    log_sink_t* sink = &logger->sinks[i];
+    if (level < sink->level) { continue; }
+    if (sink->direct) {
+      log_buf_t* line = &get_tls()->line;
+      line->len = 0;
+      bool res = sink->json ? output_json(line, item, msg)
+                            : format_line(sink->format, item, msg, line);
+      if (res) {
+        int fd = atomic_load_explicit(&sink->fd, memory_order_relaxed);
+        write_fd(fd, line->data, line->len);
+      }
+      continue;
+    }
+    if (!locked) {
+      if (!mutex_lock(&logger->out_mutex)) { return; }
+      locked = true;
+    }
+    sink_write(sink, item, msg);
+  }
+  if (!locked) { return; }
+
+  flush_sinks_by_policy(logger, level);
+  mutex_unlock(&logger->out_mutex);
+}
+
+/**
+ * @brief 複数のログデータを出力する。（ワーカー用）
+ *
+ * - すべてのログを各シンクの出力待ちデータのバッファに書き込んでから、
+ *   シンクごとにまとめて書き込む。
+ * - 出力待ちデータがフラッシュするバイト数に達した場合は途中でも
+ *   書き込む。（ローテーションするファイルの超過サイズを抑える）
+ * - 専用スレッドのシンクは、まとめて1回だけ起床させる。
+ * - 重複行をまとめる場合、直前のログと重複するログは出力を保留する。
+ * - ログデータは、すべてのシンクが参照を解放した時点でプールに返却する。
+ * @param items ログデータの配列。
+ * @param nitem ログデータの数。
+ */
+static void output_items(
+    logger_t* logger, log_item_t** items, const size_t nitem
+) {
+  log_level_t level = LOG_LEVEL_DEBUG;
+  for (size_t i = 0; i < nitem; i++) {
+    log_item_t* item = items[i];
+    if (item->site->level > level) { level = item->site->level; }
+    if (logger->coalesce_ns > 0 && coalesce_item(logger, item)) { continue; }
+    atomic_store_explicit(&item->refs, 1, memory_order_relaxed);
+    output_line(logger, item, &logger->msg, &logger->msg_cap);
+    item_unref(item);
+
+    for (size_t j = 0; j < logger->nsink; j++) {
+      log_sink_t* sink = &logger->sinks[j];
+      if (!sink->worker_running && sink->buf.len >= logger->flush_bytes) {
+        sink_flush(sink);
+      }
+    }
+  }
+
+  for (size_t i = 0; i < logger->nsink; i++) {
+    if (logger->sinks[i].worker_running) { wake_sink(&logger->sinks[i]); }
+  }
+  flush_sinks_by_policy(logger, level);
+}
+
+/**
+ * @brief 直前に出力したログと呼び出し箇所・メッセージが同じか判定する。
+ *
+ * - 遅延フォーマットの場合、メッセージを作成せずに引数の生のバイト列を
+ *   比較する。
+ * @param item ログデータ。
+ * @return 重複: true, 重複でない: false。
+ */
+static bool item_is_repeat(const logger_t* logger, const log_item_t* item) {
+  if (item->site != logger->last_site ||
+      item->deferred != logger->last_deferred) {
+    return false;
+  }
+
+  size_t size;
+  const char* data = item_get_data(item, &size);
+
+  return size == logger->last_data.len &&
+         memcmp(data, logger->last_data.data, size) == 0;
+}
+
+/**
+ * @brief 直前に出力したログと重複するログの出力を保留する。（ワーカー用）
+ *
+ * - 重複する場合、最初の重複ログのみ保留し、以降は数だけ数えてプールに
+ *   返却する。
+ * - 重複しない場合、保留中の重複ログを出力してから、比較対象を更新する。
+ * @param item ログデータ。
+ * @return 保留: true, 出力が必要: false。
+ */
+static bool coalesce_item(logger_t* logger, log_item_t* item) {
+  if (item_is_repeat(logger, item)) {
+    if (logger->repeat) {
+      item_release(item);
+    } else {
+      logger->repeat = item;
+      logger->repeat_ns = get_monotonic_ns();
+    }
+    logger->nrepeat++;
+    return true;
+  }
+
+  output_repeat(logger);
+
+  // 比較対象を更新（失敗した場合、次のログは重複として扱わない）
+  size_t size;
+  const char* data = item_get_data(item, &size);
+  logger->last_data.len = 0;
+  if (buf_append(&logger->last_data, data, size)) {
+    logger->last_site = item->site;
+    logger->last_deferred = item->deferred;
+  } else {
+    logger->last_site = NULL;
+  }
+
+  return false;
+}
+
+/**
+ * @brief 保留中の重複ログを、まとめた数を付けて1行で出力する。（ワーカー用）
+ *
+ * - 重複ログが1つの場合、そのまま出力する。
+ * - 書き込み後、flush_sinks_by_policyで出力すること。
+ */
+static void output_repeat(logger_t* logger) {
+  log_item_t* item = logger->repeat;
+  if (!item) { return; }
+
+  if (logger->nrepeat > 1) {
+    item_append_repeated(
+        item, logger->nrepeat, &logger->msg, &logger->msg_cap
+    );
+  }
+  logger->repeat = NULL;
+  logger->nrepeat = 0;
+
+  atomic_store_explicit(&item->refs, 1, memory_order_relaxed);
+  output_line(logger, item, &logger->msg, &logger->msg_cap);
+  item_unref(item);
+}
+
+/**
+ * @brief まとめる最大時間が経過した保留中の重複ログを出力する。（ワーカー用）
+ * @param force 経過時間に関わらず出力するフラグ。
+ */
+static void flush_repeat(logger_t* logger, const bool force) {
+  if (!logger->repeat) { return; }
+  if (!force && get_monotonic_ns() - logger->repeat_ns < logger->coalesce_ns) {
+    return;
+  }
+
+  log_level_t level = logger->repeat->site->level;
+  output_repeat(logger);
+  for (size_t i = 0; i < logger->nsink; i++) {
+    if (logger->sinks[i].worker_running) { wake_sink(&logger->sinks[i]); }
+  }
+  flush_sinks_by_policy(logger, level);
+}
+
+/**
+ * @brief キューにログデータを追加する。
+ *
+ * - キューのスロット数はログデータの総数以上のため、満杯にはならない。
+ *   （取り出し中のスロットが解放されるまでの一時的な失敗のみ再試行する）
+ * @param item ログデータ。
+ */
+static void enqueue_item(logger_t* logger, log_item_t* item) {
+  ring_t* queue = get_lane(logger, item->site->level)->queue;
+  while (!ring_push(queue, item)) { thrd_yield(); }
+}
+
+/**
+ * @brief キューの先頭からログデータを取得する。
+ *
+ * - ERROR専用キューを優先する。
+ * @return ログデータ。（キューが空の場合、NULL）
+ */
+static log_item_t* dequeue_item(logger_t* logger) {
+  if (logger->priority) {
+    log_item_t* item = (log_item_t*)ring_pop(logger->err_lane.queue);
+    if (item) { return item; }
+  }
+
+  return (log_item_t*)ring_pop(logger->lane.queue);
+}
+
+/**
+ * @brief すべてのキューが空か確認する。
+ * @return 空: true, 空でない: false。
+ */
+static bool queue_is_empty(const logger_t* logger) {
+  if (logger->priority && !ring_is_empty(logger->err_lane.queue)) {
+    return false;
+  }
+
+  return ring_is_empty(logger->lane.queue);
+}
+
+/**
+ * @brief キューに格納済みのログデータの数を取得する。
+ *
+ * - 取り出し位置を先に読み出し、負にならないようにする。（概算値）
+ * @return ログデータの数。
+ */
+static size_t queue_size(const logger_t* logger) {
+  size_t head = ring_head(logger->lane.queue);
+  size_t size = ring_tail(logger->lane.queue) - head;
+  if (logger->priority) {
+    head = ring_head(logger->err_lane.queue);
+    size += ring_tail(logger->err_lane.queue) - head;
+  }
+
+  return size;
+}
+
+/**
+ * @brief 前回の通知以降に破棄したログの数を出力する。（ワーカー用）
+ *
+ * - ワーカーが書き込むシンクごとに出力する。
+ *   （専用スレッドのシンクは各スレッドが出力する）
+ */
+static void output_dropped(logger_t* logger) {
+  for (size_t i = 0; i < logger->nsink; i++) {
+    if (!logger->sinks[i].worker_running) {
+      sink_output_dropped(&logger->sinks[i]);
+    }
+  }
+}
+
+/**
+ * @brief 待機中のワーカーを起床させる。
+ *
+ * - ワーカーが動作中の場合、mutexを取らずに戻る。
+ * - 待機中の場合、最初に気付いた呼び出し元のみ起床させる。（キューが空から
+ *   空でなくなった時点の1回のみ）
+ * - ログ蓄積待ち中の場合、キューのログの数がしきい値に達したか、緊急の場合
+ *   のみ起床させる。（それ以外は蓄積待ちの最大時間で起床する）
+ * @param urgent 緊急フラグ。（即時フラッシュするログレベル以上など）
+ * @return 成功: true, 失敗: false。
+ */
+static bool wake_worker(logger_t* logger, const bool urgent) {
+  // キューへの格納と待機中フラグの読み出しの順序を保証
+  atomic_thread_fence(memory_order_seq_cst);
+  atomic_bool* flag = &logger->sleeping;
+  if (!atomic_load_explicit(flag, memory_order_relaxed)) {
+    flag = &logger->batching;
+    if (!atomic_load_explicit(flag, memory_order_relaxed) ||
+        (!urgent && queue_size(logger) < logger->batch_num)) {
+      return true;
+    }
+  }
+  if (!atomic_exchange_explicit(flag, false, memory_order_relaxed)) {
+    return true;
+  }
+
+  if (!mutex_lock(&logger->mutex)) { return false; }
+  bool res = cond_signal(&logger->cond);
+  if (!mutex_unlock(&logger->mutex)) { return false; }
+
+  return res;
+}
+
+/**
+ * @brief キューにログデータが追加されるまで、しばらくスピンして待つ。
+ *
+ * - 高頻度でログが追加される場合に、待機と起床のコストを省く。
+ * @return 追加された: true, 追加されない: false。
+ */
+static bool spin_worker(const logger_t* logger) {
+  for (unsigned i = 0; i < WORKER_SPIN_NUM; i++) {
+    if (!queue_is_empty(logger)) { return true; }
+    thrd_yield();
+  }
+
+  return false;
+}
+
+/**
+ * @brief キューにログデータが追加されるまでワーカーを待機させる。
+ *
+ * - 未フラッシュのデータがある場合、次のフラッシュ時刻まで待機する。
+ * - 保留中の重複ログがある場合、まとめる最大時間まで待機する。
+ * - logger_flushの要求があった場合、待機しない。
+ * @return 継続: true, 終了: false。
+ */
+static bool park_worker(logger_t* logger) {
+  if (!mutex_lock(&logger->mutex)) { return false; }
+
+  // 待機中フラグの書き込みとキューの読み出しの順序を保証
+  atomic_store_explicit(&logger->sleeping, true, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+  while (logger->worker_running && queue_is_empty(logger) &&
+         !atomic_load_explicit(&logger->flush_pending, memory_order_relaxed)) {
+    // ワーカーが書き込むシンクのうち、最も早いフラッシュ時刻まで待機
+    uint64_t wait_ns = UINT64_MAX;
+    for (size_t i = 0; i < logger->nsink; i++) {
+      if (logger->sinks[i].worker_running) { continue; }
+      uint64_t sink_wait_ns = get_flush_wait_ns(&logger->sinks[i]);
+      if (sink_wait_ns < wait_ns) { wait_ns = sink_wait_ns; }
+    }
+    // 保留中の重複ログがある場合、まとめる最大時間まで待機
+    if (logger->repeat) {
+      uint64_t elapsed = get_monotonic_ns() - logger->repeat_ns;
+      uint64_t repeat_wait_ns =
+          elapsed >= logger->coalesce_ns ? 0 : logger->coalesce_ns - elapsed;
+      if (repeat_wait_ns < wait_ns) { wait_ns = repeat_wait_ns; }
+    }
+    bool res = true;
+    bool timeout = false;
+    if (wait_ns == UINT64_MAX) {
+      res = cond_wait(&logger->cond, &logger->mutex);
+    } else if (wait_ns > 0) {
+      res = cond_timedwait(&logger->cond, &logger->mutex, wait_ns, &timeout);
+    } else {
+      timeout = true;
+    }
+    if (!res) {
+      mutex_unlock(&logger->mutex);
+      return false;
+    }
+    // フラッシュ時刻になった場合、待機を中断
+    if (timeout) { break; }
+  }
+  atomic_store_explicit(&logger->sleeping, false, memory_order_relaxed);
+
+  bool running = logger->worker_running || !queue_is_empty(logger);
+  if (!mutex_unlock(&logger->mutex)) { return false; }
+
+  return running;
+}
+
+/**
+ * @brief キューにログデータが溜まるまでワーカーを待機させる。
+ *
+ * - 起床後、キューのログの数がしきい値に達するか、最大時間が経過するまで
+ *   待機し、1回の起床でまとめて出力する。（起床の回数を減らす）
+ * - 緊急のログが追加された場合、logger_flushの要求があった場合は待機を
+ *   中断する。
+ */
+static void batch_worker(logger_t* logger) {
+  if (logger->batch_ns == 0 || queue_is_empty(logger)) { return; }
+  if (!mutex_lock(&logger->mutex)) { return; }
+
+  // 蓄積待ちフラグの書き込みとキューの読み出しの順序を保証
+  atomic_store_explicit(&logger->batching, true, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+  uint64_t start_ns = get_monotonic_ns();
+  while (logger->worker_running && queue_size(logger) < logger->batch_num &&
+         !atomic_load_explicit(&logger->flush_pending, memory_order_relaxed)) {
+    uint64_t elapsed = get_monotonic_ns() - start_ns;
+    if (elapsed >= logger->batch_ns) { break; }
+    bool timeout = false;
+    if (!cond_timedwait(
+            &logger->cond, &logger->mutex, logger->batch_ns - elapsed, &timeout
+        ) ||
+        timeout) {
+      break;
+    }
+    // 起床させた呼び出し元がフラグを下ろした場合、待機を終了
+    if (!atomic_load_explicit(&logger->batching, memory_order_relaxed)) {
+      break;
+    }
+  }
+  atomic_store_explicit(&logger->batching, false, memory_order_relaxed);
+
+  mutex_unlock(&logger->mutex);
+}
+
+/**
+ * @brief
+ * キューに追加されたログデータをシンクへ出力する。（スレッド用ワーカー）
+ * @param arg パラメータ。（使用しない）
+ * @return NULL
+ */
+static void* worker(void* arg) {
+  logger_t* logger = (logger_t*)arg;
+
+  log_item_t* items[WORKER_BATCH_NUM];
+  size_t nline = 0;
+  while (true) {
+    // クラッシュ時は停止（シグナルハンドラが出力待ちデータを書き込む）
+    crash_park(&logger->crash_parked);
+    // キューからログデータをまとめて取得してシンクに出力
+    size_t nitem = 0;
+    while (nitem < WORKER_BATCH_NUM && (items[nitem] = dequeue_item(logger))) {
+      nitem++;
+    }
+    if (nitem > 0) {
+      output_items(logger, items, nitem);
+      // まとめる最大時間が経過した重複ログを出力
+      flush_repeat(logger, false);
+      // 破棄したログの数を一定行数ごとに出力
+      nline += nitem;
+      if (nline >= DROPPED_REPORT_INTERVAL) {
+        output_dropped(logger);
+        nline = 0;
+      }
+      // logger_flushの要求を完了
+      complete_flush_request(logger);
+      continue;
+    }
+
+    // 破棄したログの数を出力
+    output_dropped(logger);
+    // logger_flushの要求を完了
+    complete_flush_request(logger);
+
+    // キューが空の場合、しばらくスピンしてからログデータ追加待ち
+    // （終了時は無限ループを終了）
+    if (spin_worker(logger)) { continue; }
+    if (!park_worker(logger)) { break; }
+    crash_park(&logger->crash_parked);
+    // 起床をまとめる場合、ログデータが溜まるまで待機
+    batch_worker(logger);
+    crash_park(&logger->crash_parked);
+    // まとめる最大時間が経過した重複ログを出力
+    flush_repeat(logger, false);
+    // フラッシュ間隔が経過した場合、フラッシュ
+    for (size_t i = 0; i < logger->nsink; i++) {
+      if (!logger->sinks[i].worker_running) {
+        sink_flush_by_interval(&logger->sinks[i]);
+      }
+    }
+  }
+  // 保留中の重複ログを出力
+  flush_repeat(logger, true);
+
+  return NULL;
+}
+
+/**
+ * @brief シンクを設定する。
+ *
+ * - シンクの設定を指定しない場合、ログ出力フラグ等から標準出力とファイルの
+ *   シンクを作成する。
+ * - 同期モードでは専用スレッドを使用しない。
+ * - 全シンクのログレベルの最小値より低いログは、呼び出し元で破棄する。
+ * @param config ログ処理の設定。
+ * @return 成功: true, 失敗: false。
+ */
+static bool logger_set_sinks(logger_t* self, const logger_config_t* config) {
+  logger_sink_config_t defaults[2];
+  const logger_sink_config_t* sinks = config->sinks;
+  size_t nsink = config->nsink;
+  if (!sinks || nsink == 0) {
+    nsink = 0;
+    if ((config->out & LOG_STD_OUT) == LOG_STD_OUT) {
+      defaults[nsink] = logger_sink_config_default(LOG_SINK_STDOUT);
+      defaults[nsink].json = config->json;
+      defaults[nsink++].fmt = config->fmt;
+    }
+    if ((config->out & LOG_FILE_OUT) == LOG_FILE_OUT) {
+      logger_sink_config_t* sink = &defaults[nsink++];
+      *sink = logger_sink_config_default(LOG_SINK_FILE);
+      sink->fmt = config->fmt;
+      sink->fpath = config->fpath;
+      sink->binary = config->binary;
+      sink->json = config->json;
+      sink->max_fsize = config->max_fsize;
+      sink->max_fno = config->max_fno;
+    }
+    sinks = defaults;
+  }
+  if (nsink == 0) {
+    SET_ERR_LOG(ERR_INVALID_ARG, "No log sink is configured.");
+    return false;
+  }
+
+  self->sinks = (log_sink_t*)calloc(nsink, sizeof(log_sink_t));
+  if (!self->sinks) {
+    SET_ERR_LOG_AUTO(ERR_MEM_ALLOC_FAILED);
+    return false;
+  }
+  self->nsink = nsink;
+
+  self->min_level = LOG_LEVEL_ERROR;
+  self->direct = false;
+  self->stamp = 0;
+  for (size_t i = 0; i < nsink; i++) {
+    logger_sink_config_t sink = sinks[i];
+    sink.thread = sink.thread && config->async;
+    self->sinks[i].logger = self;
+    if (!sink_init(&self->sinks[i], &sink)) { return false; }
+    // 同期モードの直接書き込み（状態を持つシンクはmutexを取って書き込む）
+    log_sink_t* created = &self->sinks[i];
+    created->direct = !config->async && config->direct && !created->binary &&
+                      !created->rotator && created->recorder.cap == 0;
+    if (created->direct) { self->direct = true; }
+    // テキスト形式のシンクのログフォーマットで使用する値
+    if (!created->binary && !created->json) {
+      self->stamp |= created->format->stamp;
+    }
+    if (sink.level < self->min_level) { self->min_level = sink.level; }
+  }
+
+  return true;
+}
+
+/**
+ * @brief 遅延フォーマットを設定する。
+ *
+ * - 非同期モードのみ有効。呼び出し元スレッドでは引数の生のバイト列だけを
+ *   キューに格納し、ワーカーがメッセージをフォーマットする。
+ * - 遅延フォーマットに対応しない変換指定子を含む場合、即時フォーマットする。
+ * @param deferred 遅延フォーマットフラグ。
+ */
+static void logger_set_deferred(logger_t* self, const bool deferred) {
+  self->deferred = deferred;
+}
+
+/**
+ * @brief フラッシュポリシーを設定する。
+ * @param bytes フラッシュする未フラッシュのバイト数。（0: STREAM_BUF_SIZE）
+ * @param interval_ms フラッシュ間隔[ms]。（0: 無効）
+ * @param level 即時フラッシュするログレベル。（以上）
+ */
+static void logger_set_flush(
+    logger_t* self, const size_t bytes, const unsigned interval_ms,
+    const log_level_t level
+) {
+  self->flush_bytes = bytes > 0 ? bytes : STREAM_BUF_SIZE;
+  self->flush_ns = (uint64_t)interval_ms * 1000000;
+  self->flush_level = level;
+}
+
+/**
+ * @brief 重複行をまとめる最大時間を設定する。
+ *
+ * - 非同期モードのみ有効とし、ワーカーが連続する重複行を1行にまとめる。
+ * @param coalesce_ms まとめる最大時間[ms]。（0: 無効）
+ */
+static void logger_set_coalesce(logger_t* self, const unsigned coalesce_ms) {
+  self->coalesce_ns = (uint64_t)coalesce_ms * 1000000;
+  self->last_site = NULL;
+  self->repeat = NULL;
+  self->nrepeat = 0;
+}
+
+/**
+ * @brief ワーカーの起床をまとめる時間を設定する。
+ *
+ * - しきい値は1回に取り出す最大数とし、キューの最大数の半分を上限とする。
+ * @param batch_us ログ蓄積待ちの最大時間[us]。（0: 無効）
+ * @param nqueue キューの最大数。
+ */
+static void logger_set_batch(
+    logger_t* self, const unsigned batch_us, const size_t nqueue
+) {
+  self->batch_ns = (uint64_t)batch_us * 1000;
+  size_t half = nqueue / 2 > 0 ? nqueue / 2 : 1;
+  self->batch_num = half < WORKER_BATCH_NUM ? half : WORKER_BATCH_NUM;
+  atomic_store(&self->batching, false);
+}
+
+/**
+ * @brief 単調増加時刻（%M）の取得方法を設定する。
+ *
+ * - TSCを使用する場合、初回のみ較正する。（使用できない場合は無効）
+ * @param tsc TSCの使用フラグ。
+ */
+static void logger_set_tsc(logger_t* self, const bool tsc) {
+  if (tsc && (self->stamp & LOG_STAMP_MONO)) {
+    pthread_once(&g_tsc_once, tsc_calibrate);
+  }
+  self->tsc = tsc && g_tsc.valid;
+}
+
+/**
+ * @brief キューが満杯の場合の動作を設定する。
+ * @param overflow キューが満杯の場合の動作。
+ * @param block_ms LOG_OVERFLOW_BLOCKの待機時間[ms]。
+ *                 （0: DEFAULT_BLOCK_MS）
+ * @param priority ERROR専用キューの使用フラグ。
+ */
+static void logger_set_overflow(
+    logger_t* self, const log_overflow_t overflow, const unsigned block_ms,
+    const bool priority
+) {
+  self->overflow = overflow;
+  self->block_ms = block_ms > 0 ? block_ms : DEFAULT_BLOCK_MS;
+  self->priority = priority;
+}
+
+/**
+ * @brief 非同期モードを設定する。
+ * @param async 非同期モードフラグ。
+ * @param nqueue キューに格納するログの最大数。
+ * @return 成功: true, 失敗: false。
+ */
+static bool logger_set_async(
+    logger_t* self, const bool async, const size_t nqueue
+) {
+  self->async = async;
+  if (!self->async) { return true; }
+
+  if (!lane_init(&self->lane, nqueue)) { return false; }
+  if (self->priority && !lane_init(&self->err_lane, MAX_ERR_QUEUE_NO)) {
+    return false;
+  }
+
+  for (size_t i = 0; i < LOG_LEVEL_NUM; i++) {
+    atomic_store(&self->dropped[i], 0);
+  }
+
+  if (pthread_mutex_init(&self->mutex, NULL) != 0) {
+    SET_ERR_LOG_AUTO(ERR_MUTEX_INIT_FAILED);
+    return false;
+  }
+  if (pthread_cond_init(&self->cond, NULL) != 0) {
+    SET_ERR_LOG_AUTO(ERR_CONDITION_INIT_FAILED);
+    return false;
+  }
+  if (pthread_cond_init(&self->flush_cond, NULL) != 0) {
+    SET_ERR_LOG_AUTO(ERR_CONDITION_INIT_FAILED);
+    return false;
+  }
+  atomic_store(&self->flush_pending, false);
+  self->flush_req = 0;
+  self->flush_done = 0;
+  // シンクの専用スレッドを起動（ワーカーより先に起動）
+  for (size_t i = 0; i < self->nsink; i++) {
+    if (!sink_start(&self->sinks[i])) { return false; }
+  }
+  self->worker_running = true;
+  if (pthread_create(&self->worker, NULL, worker, self) != 0) {
+    self->worker_running = false;
+    SET_ERR_LOG_AUTO(ERR_THREAD_CREATE_FAILED);
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * @brief 設定を指定してログ処理のインスタンスを開始する。
+ * @param self ログ処理のインスタンス。
+ * @param config ログ処理の設定。
+ * @return 成功: true, 失敗: false。
+ */
+static bool logger_start(logger_t* self, const logger_config_t* config) {
+  // シンクを設定
+  if (!logger_set_sinks(self, config)) { return false; }
+  // ログレベルを設定（シンクのログレベルの最小値以上）
+  logger_set_level_of(self, config->level);
+  // 遅延フォーマットを設定
+  logger_set_deferred(self, config->async && config->deferred);
+  // フラッシュポリシーを設定
+  logger_set_flush(
+      self, config->flush_bytes, config->flush_ms, config->flush_level
+  );
+  // キューが満杯の場合の動作を設定
+  logger_set_overflow(
+      self, config->overflow, config->block_ms, config->priority
+  );
+  // 重複行をまとめる最大時間を設定
+  logger_set_coalesce(self, config->async ? config->coalesce_ms : 0);
+  // ワーカーの起床をまとめる時間を設定
+  logger_set_batch(self, config->async ? config->batch_us : 0, config->nqueue);
+  // 単調増加時刻の取得方法を設定
+  logger_set_tsc(self, config->tsc);
+  // 非同期モードを設定
+  if (!logger_set_async(self, config->async, config->nqueue)) { return false; }
+  // クラッシュ時に出力待ちデータを書き込む対象に登録
+  crash_register(self);
+
+  return true;
+}
+
+/**
+ * @brief ログ処理のインスタンスを停止し、シンクとキューを解放する。
+ *
+ * - 開始に失敗したインスタンスにも使用できる。
+ * @param self ログ処理のインスタンス。
+ */
+static void logger_stop(logger_t* self) {
+  crash_unregister(self);
+  if (self->async) {
+    // スレッドを停止
+    if (!mutex_lock(&self->mutex)) { return; }
+    bool running = self->worker_running;
+    self->worker_running = false;
+    if (!cond_signal(&self->cond)) { return; }
+    if (!mutex_unlock(&self->mutex)) { return; }
+    if (running) { pthread_join(self->worker, NULL); }
+    // シンクの専用スレッドを停止
+    for (size_t i = 0; i < self->nsink; i++) { sink_stop(&self->sinks[i]); }
+
+    lane_destroy(&self->lane);
+    lane_destroy(&self->err_lane);
+    pthread_mutex_destroy(&self->mutex);
+    pthread_cond_destroy(&self->cond);
+    pthread_cond_destroy(&self->flush_cond);
+  }
+  // 出力待ちデータを書き込み
+  flush_sinks(self);
+  for (size_t i = 0; i < self->nsink; i++) { sink_destroy(&self->sinks[i]); }
+  if (self->sinks) { free(self->sinks); }
+  self->sinks = NULL;
+  self->nsink = 0;
+  if (self->msg) { free(self->msg); }
+  self->msg = NULL;
+  self->msg_cap = 0;
+  buf_destroy(&self->last_data);
+  self->last_site = NULL;
+}
+
+/**
+ * @brief ログを設定するログデータを取得する。
+ *
+ * - 同期モードでは呼び出し元のログデータを、非同期モードではプールの
+ *   ログデータを使用する。
+ * @param self ログ処理のインスタンス。
+ * @param site 登録済みの呼び出し箇所データ。
+ * @param local 同期モードで使用するログデータ。（呼び出し元のスタック）
+ * @return ログデータ。（取得できない場合、NULL）
+ */
+static log_item_t* logger_begin_item(
+    logger_t* self, const log_site_t* site, log_item_t* local
+) {
+  if (!self->async) {
+    *local = (log_item_t){.site = site};
+    return local;
+  }
+
+  log_item_t* item = item_acquire(self, site->level);
+  if (item) { item->site = site; }
+
+  return item;
+}
+
+/**
+ * @brief ログデータに、呼び出し元で取得する時刻等を設定する。
+ *
+ * - 時刻は出力時ではなく呼び出し時の値とする。（全シンクで共通）
+ * - スレッドID、通し番号、単調増加時刻は、いずれかのシンクのログフォーマット
+ *   で使用する場合のみ取得する。
+ * @param logger ログ処理のインスタンス。
+ * @param item ログデータ。
+ */
+static void item_stamp(const logger_t* logger, log_item_t* item) {
+  if (clock_gettime(CLOCK_REALTIME, &item->ts) != 0) {
+    SET_ERR_LOG_AUTO(ERR_UNKNOWN);
+  }
+  if (logger->stamp & LOG_STAMP_THREAD) {
+    log_tls_t* tls = &g_tls;
+    if (tls->tid == 0) {
+      tls->tid = get_thread_id();
+      tls->pid = getpid();
+    }
+    item->tid = tls->tid;
+    item->pid = tls->pid;
+  }
+  if (logger->stamp & LOG_STAMP_SEQ) {
+    item->seq = atomic_fetch_add_explicit(&g_seq, 1, memory_order_relaxed) + 1;
+  }
+  if (logger->stamp & LOG_STAMP_MONO) {
+    item->mono_ns = logger->tsc ? get_tsc_ns() : get_monotonic_ns();
+  }
+}
+
+/**
+ * @brief メッセージを設定したログデータを出力する。
+ *
+ * - 同期モードでは直接書き出し、非同期モードではキューに追加する。
+ * - メッセージの設定に失敗した場合、ログデータを破棄する。
+ * @param self ログ処理のインスタンス。
+ * @param item logger_begin_itemで取得したログデータ。
+ * @param res メッセージの設定結果。
+ */
+static void logger_end_item(logger_t* self, log_item_t* item, const bool res) {
+  if (res) { item_stamp(self, item); }
+
+  // 同期モード（直接書き出し）
+  if (!self->async) {
+    if (res && self->direct) {
+      output_direct(self, item);
+    } else if (res && mutex_lock(&self->out_mutex)) {
+      output_line(self, item, &self->msg, &self->msg_cap);
+      flush_sinks_by_policy(self, item->site->level);
+      mutex_unlock(&self->out_mutex);
+    }
+    item_clear(item);
+    return;
+  }
+
+  // 非同期モード（キューに追加）
+  if (!res) {
+    item_release(item);
+    return;
+  }
+  // 格納後はワーカーが解放するため、格納前に判定
+  bool urgent = item->site->level >= self->flush_level;
+  enqueue_item(self, item);
+  wake_worker(self, urgent);
+}
+
+/**
+ * @brief ログ処理のインスタンスにログを出力する。
+ *
+ * - 出力制限で抑制したログがある場合、即時フォーマットしてメッセージの
+ *   末尾に抑制した数を付ける。
+ * @param self ログ処理のインスタンス。
+ * @param site 呼び出し箇所データ。
+ * @param suppressed 前回の出力以降に抑制したログの数。
+ * @param fmt 可変長メッセージ。
+ * @param ap 可変長引数。（呼び出し元でva_endすること）
+ */
+static void logger_vlog(
+    logger_t* self, log_site_t* site, const size_t suppressed, const char* fmt,
+    va_list ap
+) {
+  if (!logger_site_enabled(self, site, site->level)) { return; }
+
+  site = site_register(site);
+
+  log_item_t local;
+  log_item_t* item = logger_begin_item(self, site, &local);
+  if (!item) { return; }
+
+  // 遅延フォーマットは非同期モードのみ有効
+  bool res = (self->deferred && suppressed == 0 && site->args &&
+              site->args->deferrable)
+                 ? item_set_args(item, ap)
+                 : item_set_msg(item, fmt, ap);
+  if (res && suppressed > 0) { item_append_suppressed(item, suppressed); }
+
+  logger_end_item(self, item, res);
+}
+
+/**
+ * @brief クラッシュ時に、ワーカーまたは専用スレッドを停止させる。
+ *
+ * - シグナルハンドラが出力待ちデータを書き込む間、同じデータへの書き込みを
+ *   止める。（ハンドラはシグナルを再送してプロセスを終了させる）
+ * - 処理中のログをすべてシンクに書き込んでから呼び出すこと。
+ * @param parked 停止済みフラグ。
+ */
+static void crash_park(atomic_bool* parked) {
+  if (!atomic_load_explicit(&g_crash_active, memory_order_relaxed)) { return; }
+
+  atomic_store(parked, true);
+  while (true) { pause(); }
+}
+
+/**
+ * @brief クラッシュ時に、ワーカーまたは専用スレッドの停止を待機する。
+ *
+ * - 待機中（キューが空）またはログ蓄積待ち中の場合、処理中のログはないため
+ *   待たない。
+ * - クラッシュしたスレッド自身の場合は停止しないため、最大時間で打ち切る。
+ * @param running 実行フラグ。
+ * @param parked 停止済みフラグ。
+ * @param sleeping 待機中フラグ。
+ * @param batching ログ蓄積待ち中フラグ。（NULL: なし）
+ */
+static void crash_wait_parked(
+    const bool running, const atomic_bool* parked, const atomic_bool* sleeping,
+    const atomic_bool* batching
+) {
+  if (!running) { return; }
+
+  struct timespec interval = {.tv_sec = 0, .tv_nsec = 1000000};
+  for (unsigned i = 0; i < CRASH_WAIT_MS; i++) {
+    if (atomic_load(parked) || atomic_load(sleeping)) { return; }
+    if (batching && atomic_load(batching)) { return; }
+    nanosleep(&interval, NULL);
+  }
+}
+
+/**
+ * @brief クラッシュ時に出力待ちデータを書き込む対象にインスタンスを登録する。
+ *
+ * - 空きがない場合、登録しない。（クラッシュ時の書き込みは行わない）
+ * @param logger ログ処理のインスタンス。
+ */
+static void crash_register(logger_t* logger) {
+  for (size_t i = 0; i < LOG_CRASH_LOGGER_NUM; i++) {
+    if (atomic_load(&g_crash_loggers[i]) == logger) { return; }
+  }
+  for (size_t i = 0; i < LOG_CRASH_LOGGER_NUM; i++) {
+    logger_t* expected = NULL;
+    if (atomic_compare_exchange_strong(
+            &g_crash_loggers[i], &expected, logger
+        )) {
+      return;
+    }
+  }
+}
+
+/**
+ * @brief クラッシュ時に出力待ちデータを書き込む対象からインスタンスを外す。
+ * @param logger ログ処理のインスタンス。
+ */
+static void crash_unregister(logger_t* logger) {
+  for (size_t i = 0; i < LOG_CRASH_LOGGER_NUM; i++) {
+    logger_t* expected = logger;
+    atomic_compare_exchange_strong(&g_crash_loggers[i], &expected, NULL);
+  }
+}
+
+/**
+ * @brief データをfdに書き込む。（シグナルハンドラ用）
+ *
+ * - 以降のcrash_*関数はシグナルハンドラから呼び出すため、メモリの確保、
+ *   stdio、ロックを使用せず、非同期シグナル安全な関数のみ使用する。
+ * - 失敗した場合、エラーは通知せずに残りを破棄する。
+ * @param fd ファイルディスクリプタ。
+ * @param data データ。
+ * @param size データのバイト数。
+ */
+static void crash_write_fd(const int fd, const char* data, const size_t size) {
+  size_t pos = 0;
+  while (pos < size) {
+    ssize_t n = write(fd, data + pos, size - pos);
+    if (n < 0 && errno == EINTR) { continue; }
+    if (n <= 0) { return; }
+    pos += (size_t)n;
+  }
+}
+
+/**
+ * @brief クラッシュ時の書き込みバッファのデータをfdに書き込む。
+ * @param self クラッシュ時の書き込みバッファ。
+ */
+static void crash_flush(log_crash_buf_t* self) {
+  crash_write_fd(self->fd, self->data, self->len);
+  self->len = 0;
+}
+
+/**
+ * @brief クラッシュ時の書き込みバッファにデータを書き込む。
+ *
+ * - バッファが満杯になった場合、fdに書き込んでから続ける。
+ * @param self クラッシュ時の書き込みバッファ。
+ * @param data データ。
+ * @param size データのバイト数。
+ */
+static void crash_write(log_crash_buf_t* self, const char* data, size_t size) {
+  if (size == 0) { return; }
+  self->last = data[size - 1];
+  while (size > 0) {
+    if (self->len == sizeof(self->data)) { crash_flush(self); }
+    size_t n = sizeof(self->data) - self->len;
+    if (n > size) { n = size; }
+    memcpy(self->data + self->len, data, n);
+    self->len += n;
+    data += n;
+    size -= n;
+  }
+}
+
+/**
+ * @brief クラッシュ時の書き込みバッファに文字列を書き込む。
+ * @param self クラッシュ時の書き込みバッファ。
+ * @param str 文字列。
+ */
+static void crash_write_str(log_crash_buf_t* self, const char* str) {
+  crash_write(self, str, strlen(str));
+}
+
+/**
+ * @brief クラッシュ時の書き込みバッファに符号なし整数を10進数で書き込む。
+ * @param self クラッシュ時の書き込みバッファ。
+ * @param value 整数。
+ */
+static void crash_write_uint(log_crash_buf_t* self, unsigned long long value) {
+  char digits[ARGFMT_DEC_SIZE];
+  crash_write(self, digits, argfmt_put_uint(digits, value));
+}
+
+/**
+ * @brief クラッシュ時の書き込みバッファに符号付き整数を10進数で書き込む。
+ * @param self クラッシュ時の書き込みバッファ。
+ * @param value 整数。
+ */
+static void crash_write_int(log_crash_buf_t* self, const long long value) {
+  if (value >= 0) {
+    crash_write_uint(self, (unsigned long long)value);
+    return;
+  }
+  crash_write(self, "-", 1);
+  crash_write_uint(self, 0ull - (unsigned long long)value);
+}
+
+/**
+ * @brief クラッシュ時の書き込みバッファに浮動小数点数を書き込む。
+ *
+ * - snprintfを使用できないため、小数点以下6桁の固定小数点で書き込む。
+ *   （整数部が64ビットに収まらない値と、無限大、NaNはnullとする）
+ * @param self クラッシュ時の書き込みバッファ。
+ * @param value 浮動小数点数。
+ */
+static void crash_write_double(log_crash_buf_t* self, const double value) {
+  if (!isfinite(value) || fabs(value) >= 1e18) {
+    crash_write(self, "null", 4);
+    return;
+  }
+
+  double abs = fabs(value);
+  unsigned long long ipart = (unsigned long long)abs;
+  unsigned frac = (unsigned)((abs - (double)ipart) * 1e6 + 0.5);
+  if (frac >= 1000000) {
+    ipart++;
+    frac -= 1000000;
+  }
+  if (value < 0) { crash_write(self, "-", 1); }
+  crash_write_uint(self, ipart);
+  char digits[1 + 6] = {'.'};
+  argfmt_put_digits(digits + 1, frac, 6);
+  crash_write(self, digits, sizeof(digits));
+}
+
+/**
+ * @brief クラッシュ時の書き込みバッファにJSON文字列をエスケープして書き込む。
+ * @param self クラッシュ時の書き込みバッファ。
+ * @param str 文字列。
+ */
+static void crash_write_json(log_crash_buf_t* self, const char* str) {
+  static const char hex[] = "0123456789abcdef";
+  const char* start = str;
+  for (; *str; str++) {
+    unsigned char ch = (unsigned char)*str;
+    if (ch >= 0x20 && ch != '"' && ch != '\\') { continue; }
+
+    char esc[6] = {'\\', (char)ch, '0', '0', hex[ch >> 4], hex[ch & 0xf]};
+    size_t esc_len = 2;
+    switch (ch) {
+      case '\n':
+        esc[1] = 'n';
+        break;
+      case '\r':
+        esc[1] = 'r';
+        break;
+      case '\t':
+        esc[1] = 't';
+        break;
+      case '\b':
+        esc[1] = 'b';
+        break;
+      case '\f':
+        esc[1] = 'f';
+        break;
+      case '"':
+      case '\\':
+        break;
+      default:
+        esc[1] = 'u';
+        esc_len = sizeof(esc);
+        break;
+    }
+    crash_write(self, start, (size_t)(str - start));
+    crash_write(self, esc, esc_len);
+    start = str + 1;
+  }
+  crash_write(self, start, (size_t)(str - start));
+}
+
+/**
+ * @brief クラッシュ時の書き込みバッファに構造化ログのフィールドの値を
+ *        書き込む。
+ * @param self クラッシュ時の書き込みバッファ。
+ * @param field フィールド。
+ * @param json JSON形式フラグ。（文字列をエスケープして引用符で囲む）
+ */
+static void crash_write_field_value(
+    log_crash_buf_t* self, const log_field_t* field, const bool json
+) {
+  switch (field->type) {
+    case LOG_FIELD_INT:
+      crash_write_int(self, field->value.i);
+      break;
+    case LOG_FIELD_UINT:
+      crash_write_uint(self, field->value.u);
+      break;
+    case LOG_FIELD_DOUBLE:
+      crash_write_double(self, field->value.d);
+      break;
+    case LOG_FIELD_BOOL:
+      crash_write_str(self, field->value.b ? "true" : "false");
+      break;
+    case LOG_FIELD_STR:
+    default:
+      if (!field->value.s) {
+        crash_write_str(self, json ? "null" : "(null)");
+      } else if (json) {
+        crash_write(self, "\"", 1);
+        crash_write_json(self, field->value.s);
+        crash_write(self, "\"", 1);
+      } else {
+        crash_write_str(self, field->value.s);
+      }
+      break;
+  }
+}
+
+/**
+ * @brief クラッシュ時の書き込みバッファに出力待ちのログを1行書き込む。
+ *
+ * - シンクのログフォーマットに従う。ただし、タイムスタンプは
+ *   localtime_rを使用できないため、呼び出し時のUNIX時刻の秒数とする。
+ * - 遅延フォーマットの場合、引数をフォーマットせずにフォーマット文字列を
+ *   書き込む。
+ * @param self クラッシュ時の書き込みバッファ。
+ * @param format コンパイル済みログフォーマット。
+ * @param item ログデータ。
+ */
+static void crash_write_line(
+    log_crash_buf_t* self, const log_format_t* format, const log_item_t* item
+) {
+  const log_site_t* site = item->site;
+  self->last = '\0';
+  for (size_t i = 0; i < format->nop; i++) {
+    const log_format_op_t* op = &format->ops[i];
+    switch (op->type) {
+      case LOG_FORMAT_OP_LITERAL:
+        crash_write(self, op->str, op->len);
+        break;
+      case LOG_FORMAT_OP_TIME:
+        crash_write_int(self, item->ts.tv_sec);
+        break;
+      case LOG_FORMAT_OP_MSEC: {
+        char digits[ARGFMT_DEC_SIZE];
+        argfmt_put_digits(
+            digits, (unsigned)(item->ts.tv_nsec / 1000000), MSEC_DIGITS
+        );
+        crash_write(self, digits, MSEC_DIGITS);
+        break;
+      }
+      case LOG_FORMAT_OP_USEC: {
+        char digits[ARGFMT_DEC_SIZE];
+        argfmt_put_digits(
+            digits, (unsigned)(item->ts.tv_nsec / 1000), USEC_DIGITS
+        );
+        crash_write(self, digits, USEC_DIGITS);
+        break;
+      }
+      case LOG_FORMAT_OP_LEVEL: {
+        const char* level = get_level_name(site->level);
+        size_t len = strlen(level);
+        crash_write(self, level, len);
+        if (len < LEVEL_WIDTH) {
+          crash_write(self, "     ", LEVEL_WIDTH - len);
+        }
+        break;
+      }
+      case LOG_FORMAT_OP_FNAME:
+        crash_write_str(self, site->fname);
+        break;
+      case LOG_FORMAT_OP_LINE:
+        crash_write_int(self, site->line);
+        break;
+      case LOG_FORMAT_OP_FUNC:
+        crash_write_str(self, site->func);
+        break;
+      case LOG_FORMAT_OP_MSG: {
+        if (item->deferred) {
+          crash_write_str(self, site->fmt);
+          crash_write_str(self, " (unformatted)");
+          break;
+        }
+        crash_write_str(self, item->msg ? item->msg : "");
+        if (item->kv_len == 0) { break; }
+        const char* data = item_get_fields(item);
+        const char* end = data + item->kv_len;
+        while (data < end) {
+          log_field_t field;
+          data = field_decode(data, &field);
+          crash_write(self, " ", 1);
+          crash_write_str(self, field.key);
+          crash_write(self, "=", 1);
+          crash_write_field_value(self, &field, false);
+        }
+        break;
+      }
+      case LOG_FORMAT_OP_TID:
+        crash_write_int(self, item->tid);
+        break;
+      case LOG_FORMAT_OP_PID:
+        crash_write_int(self, item->pid);
+        break;
+      case LOG_FORMAT_OP_SEQ:
+        crash_write_uint(self, item->seq);
+        break;
+      case LOG_FORMAT_OP_MONO:
+        crash_write_uint(self, item->mono_ns);
+        break;
+    }
+  }
+
+  // 終端処理
+  if (self->last != '\n') { crash_write(self, "\n", 1); }
+}
+
+/**
+ * @brief クラッシュ時の書き込みバッファに出力待ちのログをJSON Lines形式で
+ *        1行書き込む。
+ *
+ * - 時刻は呼び出し時のUNIX時刻（秒.ナノ秒）とし、出力待ちだったことを示す
+ *   "pending"を加える。
+ * - 遅延フォーマットの場合、フォーマット文字列をメッセージとする。
+ * @param self クラッシュ時の書き込みバッファ。
+ * @param item ログデータ。
+ */
+static void crash_write_json_line(
+    log_crash_buf_t* self, const log_item_t* item
+) {
+  const log_site_t* site = item->site;
+  if (!site->json) { return; }
+
+  char digits[ARGFMT_DEC_SIZE];
+  argfmt_put_digits(digits, (unsigned)item->ts.tv_nsec, NSEC_DIGITS);
+  crash_write_str(self, "{\"time\":");
+  crash_write_int(self, item->ts.tv_sec);
+  crash_write(self, ".", 1);
+  crash_write(self, digits, NSEC_DIGITS);
+  crash_write_str(self, site->json);
+  crash_write_json(self, item->deferred ? site->fmt : item->msg);
+  crash_write_str(self, "\",\"pending\":true");
+  if (!item->deferred && item->kv_len > 0) {
+    const char* data = item_get_fields(item);
+    const char* end = data + item->kv_len;
+    while (data < end) {
+      log_field_t field;
+      data = field_decode(data, &field);
+      crash_write_str(self, field.json_key);
+      crash_write_field_value(self, &field, true);
+    }
+  }
+  crash_write(self, "}\n", 2);
+}
+
+/**
+ * @brief 出力待ちのログをシンクのfdに書き込む。
+ *
+ * - バイナリ形式のシンクには書き込まない。（呼び出し箇所の書き込み済み
+ *   フラグ等の状態を更新する必要があるため）
+ * @param sink シンク。
+ * @param fd 書き込み先のfd。
+ * @param item ログデータ。
+ */
+static void crash_write_item(
+    const log_sink_t* sink, const int fd, const log_item_t* item
+) {
+  if (sink->binary || !sink->format || !item->site) { return; }
+
+  log_crash_buf_t buf;
+  buf.fd = fd;
+  buf.len = 0;
+  buf.last = '\0';
+  if (sink->json) {
+    crash_write_json_line(&buf, item);
+  } else {
+    crash_write_line(&buf, sink->format, item);
+  }
+  crash_flush(&buf);
+}
+
+/**
+ * @brief インスタンスの出力待ちデータとキューのログを書き込む。
+ *
+ * - 以下の順に書き込む。
+ *   1. 各シンクのフライトレコーダのログと出力待ちデータ（フォーマット済みで
+ *      未フラッシュのもの）
+ *   2. 専用スレッドのシンクのキューのログ
+ *   3. ERROR専用キュー、通常のキューのログ（ログレベルを満たす全シンク）
+ * - ワーカーと専用スレッドが処理中のログをシンクに書き込んで停止するまで
+ *   待ってから書き込む。（停止しない場合、処理中のログは失われることがある）
+ * - 最後にファイルのシンクをfsyncする。
+ * @param logger ログ処理のインスタンス。
+ */
+static void crash_dump_logger(logger_t* logger) {
+  log_sink_t* sinks = logger->sinks;
+  size_t nsink = logger->nsink;
+  if (!sinks) { return; }
+
+  // ワーカーと専用スレッドの停止を待機
+  crash_wait_parked(
+      logger->async && logger->worker_running, &logger->crash_parked,
+      &logger->sleeping, &logger->batching
+  );
+  for (size_t i = 0; i < nsink; i++) {
+    crash_wait_parked(
+        sinks[i].worker_running, &sinks[i].crash_parked, &sinks[i].sleeping,
+        NULL
+    );
+  }
+
+  for (size_t i = 0; i < nsink; i++) {
+    log_sink_t* sink = &sinks[i];
+    int fd = atomic_load(&sink->fd);
+    if (fd < 0) { continue; }
+
+    // フライトレコーダのログ（古いものから）
+    const log_recorder_t* recorder = &sink->recorder;
+    if (recorder->len > 0) {
+      size_t n = recorder->cap - recorder->head;
+      if (n > recorder->len) { n = recorder->len; }
+      crash_write_fd(fd, recorder->data + recorder->head, n);
+      crash_write_fd(fd, recorder->data, recorder->len - n);
+    }
+    if (sink->buf.data) { crash_write_fd(fd, sink->buf.data, sink->buf.len); }
+    if (!sink->queue) { continue; }
+    log_item_t* item = NULL;
+    while ((item = (log_item_t*)ring_pop(sink->queue)) != NULL) {
+      crash_write_item(sink, fd, item);
+    }
+  }
+
+  if (logger->async) {
+    ring_t* queues[] = {logger->err_lane.queue, logger->lane.queue};
+    for (size_t q = 0; q < sizeof(queues) / sizeof(queues[0]); q++) {
+      if (!queues[q]) { continue; }
+      log_item_t* item = NULL;
+      while ((item = (log_item_t*)ring_pop(queues[q])) != NULL) {
+        if (!item->site) { continue; }
+        for (size_t i = 0; i < nsink; i++) {
+          int fd = atomic_load(&sinks[i].fd);
+          if (fd < 0 || item->site->level < sinks[i].level) { continue; }
+          crash_write_item(&sinks[i], fd, item);
+        }
+      }
+    }
+  }
+
+  for (size_t i = 0; i < nsink; i++) {
+    int fd = atomic_load(&sinks[i].fd);
+    if (fd >= 0 && sinks[i].type == LOG_SINK_FILE) { fsync(fd); }
+  }
+}
+
+/**
+ * @brief 致命的なシグナルのハンドラ。
+ *
+ * - 登録済みの全インスタンスの出力待ちデータとキューのログを書き込んでから、
+ *   設定前の動作に戻してシグナルを再送する。
+ * - 複数のスレッドで同時に発生した場合、最初の1回のみ書き込む。
+ * @param sig シグナル番号。
+ */
+static void crash_handler(int sig) {
+  int saved_errno = errno;
+  if (!atomic_exchange(&g_crash_active, true)) {
+    for (size_t i = 0; i < LOG_CRASH_LOGGER_NUM; i++) {
+      logger_t* logger = atomic_load(&g_crash_loggers[i]);
+      if (logger) { crash_dump_logger(logger); }
+    }
+  }
+
+  for (size_t i = 0; i < LOG_CRASH_SIGNAL_NUM; i++) {
+    if (CRASH_SIGNALS[i] == sig) {
+      sigaction(sig, &g_crash_actions[i], NULL);
+    }
+  }
+  errno = saved_errno;
+  raise(sig);
+}
+
+// ----------------------------------------------------------------------------
+// 以降、公開関数
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief デフォルトのログ処理の設定を取得する。
+ * @return ログ処理の設定。
+ */
+logger_config_t logger_config_default(void) {
+  logger_config_t config = {
+      .out = LOG_BOTH_OUT,
+      .level = LOG_LEVEL_INFO,
+      .fmt = NULL,
+      .async = true,
+      .fpath = NULL,
+      .deferred = false,
+      .binary = false,
+      .json = false,
+      .direct = false,
+      .nqueue = MAX_QUEUE_NO,
+      .overflow = LOG_OVERFLOW_DROP_OLDEST,
+      .block_ms = 0,
+      .priority = false,
+      .flush_bytes = 0,
+      .flush_ms = 1000,
+      .flush_level = LOG_LEVEL_ERROR,
+      .coalesce_ms = 0,
+      .batch_us = 0,
+      .tsc = false,
+      .max_fsize = 0,
+      .max_fno = 5,
+      .sinks = NULL,
+      .nsink = 0,
+  };
+
+  return config;
+}
+
+/**
+ * @brief デフォルトのシンクの設定を取得する。
+ *
+ * - ログレベルはLOG_LEVEL_DEBUG（全体のログレベルのみ適用）とする。
+ * @param type シンクの種類。
+ * @return シンクの設定。
+ */
+logger_sink_config_t logger_sink_config_default(const log_sink_type_t type) {
+  logger_sink_config_t config = {
+      .type = type,
+      .level = LOG_LEVEL_DEBUG,
+      .fmt = NULL,
+      .fpath = NULL,
+      .binary = false,
+      .json = false,
+      .max_fsize = 0,
+      .max_fno = 5,
+      .thread = false,
+      .nqueue = MAX_SINK_QUEUE_NO,
+      .recorder = 0,
+  };
+
+  return config;
+}
+
+/**
+ * @brief 設定を指定してログ処理を初期化する。
+ *
+ * - LOG_*マクロが出力するデフォルトのインスタンスを初期化する。
+ * @param config ログ処理の設定。
+ * @return 成功: true, 失敗: false。
+ */
+bool logger_init_config(const logger_config_t* config) {
+  if (!config) {
+    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
+    return false;
+  }
+
+  if (!logger_start(&g_logger, config)) {
+    logger_stop(&g_logger);
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * @brief ログ処理を初期化する。
+ * @param out ログ出力フラグ。
+ * @param level ログレベル。
+ * @param fmt ログフォーマット。
+ * @param async 非同期モードフラグ。
+ * @param fpath ログファイルパス。（NULLの場合、stderr）
+ * @return 成功: true, 失敗: false。
  */
-static log_item_t* dequeue_item(void) {
-  if (!g_param.async) {
-    SET_ERR_LOG_AUTO(ERR_UNKNOWN);
-    return NULL;
-  }
+bool logger_init(
+    const log_out_t out, const log_level_t level, const char* fmt,
+    const bool async, const char* fpath
+) {
+  logger_config_t config = logger_config_default();
+  config.out = out;
+  config.level = level;
+  config.fmt = fmt;
+  config.async = async;
+  config.fpath = fpath;
 
-  log_item_t* item = NULL;
-  if (g_param.q_count > 0) {
-    item = g_param.queue[g_param.q_head];
-    g_param.q_head = (g_param.q_head + 1) % g_param.nqueue;
-    g_param.q_count--;
-  }
+  return logger_init_config(&config);
+}
 
-  return item;
+/**
+ * @brief ログ処理を終了する。
+ */
+void logger_close(void) { logger_stop(&g_logger); }
+
+/**
+ * @brief 非同期モードで破棄したログの数を取得する。
+ *
+ * - キューの最大数の見積もりに使用する。
+ * @param level ログレベル。
+ * @return 破棄したログの数。（logger_init以降の累計）
+ */
+size_t logger_get_dropped(const log_level_t level) {
+  return logger_get_dropped_from(&g_logger, level);
 }
 
 /**
- * @brief
- * キューに追加されたログデータをストリームへ出力する。（スレッド用ワーカー）
- * @param arg パラメータ。（使用しない）
- * @return NULL
+ * @brief 出力済みのログをフラッシュする。
+ *
+ * - 非同期モードの場合、呼び出し時点でキューに格納済みのログをすべて
+ *   出力し、フラッシュするまで待機する。
+ * @return 成功: true, 失敗: false。
  */
-static void* worker(void* arg) {
-  (void)arg;
+bool logger_flush(void) { return logger_flush_to(&g_logger); }
 
-  while (true) {
-    if (!mutex_lock(&g_param.mutex)) { return NULL; }
+/**
+ * @brief ログを出力する。
+ *
+ * - 通常は本関数をラップしたマクロを使用する。
+ * - ログデータは呼び出し箇所データを参照するため、ファイル名等をコピーしない。
+ *
+ * @param site 呼び出し箇所データ。
+ * @param fmt 可変長メッセージ。
+ */
+void logger_log(log_site_t* site, const char* fmt, ...) {
+  if (!site || !fmt) { return; }
 
-    // キューへのログデータ追加待ち
-    while (g_param.worker_running && g_param.q_count == 0) {
-      if (!cond_wait(&g_param.cond, &g_param.mutex)) { return NULL; }
-    }
+  va_list ap;
+  va_start(ap, fmt);
+  logger_vlog(&g_logger, site, 0, fmt, ap);
+  va_end(ap);
+}
 
-    // 無限ループを終了
-    if (!g_param.worker_running && g_param.q_count == 0) {
-      if (!mutex_unlock(&g_param.mutex)) { return NULL; }
-      break;
-    }
+/**
+ * @brief ログ処理のインスタンスを作成する。
+ *
+ * - インスタンスごとにキュー、ワーカー、シンクを持つため、あるインスタンスの
+ *   キューが満杯になっても他のインスタンスのログは破棄されない。
+ * - 同じファイルを複数のインスタンスのシンクに指定しないこと。
+ * @param config ログ処理の設定。
+ * @return ログ処理のインスタンス。（失敗: NULL）
+ */
+logger_t* logger_create(const logger_config_t* config) {
+  if (!config) {
+    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
+    return NULL;
+  }
 
-    // キューからログデータを取得してストリームに出力
-    log_item_t* item = dequeue_item();
+  logger_t* self = (logger_t*)calloc(1, sizeof(*self));
+  if (!self) {
+    SET_ERR_LOG_AUTO(ERR_MEM_ALLOC_FAILED);
+    return NULL;
+  }
+  if (pthread_mutex_init(&self->out_mutex, NULL) != 0) {
+    SET_ERR_LOG_AUTO(ERR_MUTEX_INIT_FAILED);
+    free(self);
+    return NULL;
+  }
+  if (!logger_start(self, config)) {
+    logger_destroy(&self);
+    return NULL;
+  }
 
-    if (!mutex_unlock(&g_param.mutex)) { return NULL; }
+  return self;
+}
 
-    if (item) {
-      output_line(item);
-      log_item_destroy(&item);
-    }
+/**
+ * @brief ログ処理のインスタンスを終了し、解放する。
+ *
+ * - デフォルトのインスタンスはlogger_closeで終了すること。
+ * @param self ログ処理のインスタンス。
+ */
+void logger_destroy(logger_t** self) {
+  if (!self || !*self) { return; }
+  if (*self == &g_logger) {
+    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
+    return;
   }
 
-  return NULL;
+  logger_stop(*self);
+  pthread_mutex_destroy(&(*self)->out_mutex);
+  free(*self);
+  *self = NULL;
 }
 
 /**
- * @brief ログ出力フラグを設定する。
- * @param out ログ出力フラグ。
+ * @brief デフォルトのインスタンスを取得する。
+ *
+ * - LOG_*マクロの出力先。logger_initで初期化する。
+ * @return デフォルトのインスタンス。
  */
-static void logger_set_out(const log_out_t out) { g_param.out = out; }
+logger_t* logger_get_default(void) { return &g_logger; }
 
 /**
- * @brief ログレベルを設定する。
+ * @brief 非同期モードのインスタンスで破棄したログの数を取得する。
+ * @param self ログ処理のインスタンス。
  * @param level ログレベル。
+ * @return 破棄したログの数。（インスタンスの開始以降の累計）
  */
-static void logger_set_level(const log_level_t level) { g_param.level = level; }
+size_t logger_get_dropped_from(const logger_t* self, const log_level_t level) {
+  if (!self || (unsigned)level >= LOG_LEVEL_NUM) {
+    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
+    return 0;
+  }
+
+  return atomic_load_explicit(&self->dropped[level], memory_order_relaxed);
+}
 
 /**
- * @brief ログフォーマットを設定する。
+ * @brief インスタンスに出力済みのログをフラッシュする。
  *
- * デフォルトフォーマット: [%T][%l][%F:%L][%f()] - %m
+ * - 非同期モードの場合、呼び出し時点でキューに格納済みのログをすべて
+ *   出力し、フラッシュするまで待機する。
+ * @param self ログ処理のインスタンス。
+ * @return 成功: true, 失敗: false。
+ */
+bool logger_flush_to(logger_t* self) {
+  if (!self) {
+    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
+    return false;
+  }
+
+  // 同期モード
+  if (!self->async) {
+    if (!mutex_lock(&self->out_mutex)) { return false; }
+    flush_sinks(self);
+    return mutex_unlock(&self->out_mutex);
+  }
+
+  // 非同期モード（ワーカーに要求して完了を待機）
+  if (!mutex_lock(&self->mutex)) { return false; }
+  if (!self->worker_running) {
+    mutex_unlock(&self->mutex);
+    SET_ERR_LOG_AUTO(ERR_INVALID_STATE);
+    return false;
+  }
+  uint64_t req = ++self->flush_req;
+  self->flush_pos = ring_tail(self->lane.queue);
+  if (self->priority) {
+    self->flush_err_pos = ring_tail(self->err_lane.queue);
+  }
+  atomic_store_explicit(&self->flush_pending, true, memory_order_release);
+  bool res = cond_signal(&self->cond);
+  while (res && !flush_completed(self, req)) {
+    res = cond_wait(&self->flush_cond, &self->mutex);
+  }
+  if (!mutex_unlock(&self->mutex)) { return false; }
+
+  return res;
+}
+
+/**
+ * @brief 指定したインスタンスにログを出力する。
  *
- * 変換指定子:
- * - %T : タイムスタンプ (YYYY-MM-DD HH:MM:SS)
- * - %l : ログレベル (DEBUG/INFO/WARN/ERROR)
- * - %F : ファイル名
- * - %L : 行番号
- * - %f : 関数名
- * - %m : メッセージ
+ * - 通常は本関数をラップしたLOGGER_*マクロを使用する。
+ * @param self ログ処理のインスタンス。
+ * @param site 呼び出し箇所データ。
+ * @param fmt 可変長メッセージ。
+ */
+void logger_log_to(logger_t* self, log_site_t* site, const char* fmt, ...) {
+  if (!self || !site || !fmt) { return; }
+
+  va_list ap;
+  va_start(ap, fmt);
+  logger_vlog(self, site, 0, fmt, ap);
+  va_end(ap);
+}
+
+/**
+ * @brief ログレベルを変更する。（デフォルトのインスタンス）
  *
- * @param fmt ログフォーマット。
+ * - 実行中のどのスレッドからでも変更できる。
+ * @param level ログレベル。
  */
-static bool logger_set_format(const char* fmt) {
-  fmt = fmt ? fmt : DEFAULT_FORMAT;
+void logger_set_level(const log_level_t level) {
+  logger_set_level_of(&g_logger, level);
+}
 
-  if (g_param.format) { free(g_param.format); }
-  g_param.format = format_init(fmt);
-  if (!g_param.format) { return false; }
+/**
+ * @brief インスタンスのログレベルを変更する。
+ *
+ * - 実行中のどのスレッドからでも変更できる。（ログ出力用マクロは
+ *   引数を評価する前にアトミックに読み出して判定する）
+ * - 全シンクのログレベルの最小値より低いログレベルは、その最小値とする。
+ * @param self ログ処理のインスタンス。
+ * @param level ログレベル。
+ */
+void logger_set_level_of(logger_t* self, const log_level_t level) {
+  if (!self || (unsigned)level >= LOG_LEVEL_NUM) {
+    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
+    return;
+  }
 
-  return true;
+  log_level_t effective = level < self->min_level ? self->min_level : level;
+  atomic_store_explicit(
+      &self->head.level, (int)effective, memory_order_relaxed
+  );
 }
 
 /**
- * @brief ログストリームを設定する。
- * @param fpath ファイルパス。
- * @param bufsize ファイルパスのバッファサイズ。
+ * @brief モジュールごとのログレベルを設定する。
+ *
+ * - モジュール名（LOG_MODULE）、ファイル名、拡張子を除くファイル名のいずれか
+ *   に一致する呼び出し箇所は、インスタンスのログレベルの代わりにこの
+ *   ログレベルで判定する。（すべてのインスタンスに適用する）
+ * - 設定済みのモジュールの場合、ログレベルを上書きする。
+ * - 呼び出し箇所は次のログ出力時に1回だけ再解決し、以降はキャッシュした
+ *   結果で判定する。
+ * @param module モジュール名またはファイル名。
+ * @param level ログレベル。
  * @return 成功: true, 失敗: false。
  */
-static bool logger_set_stream(const char* fpath) {
-  if (!fpath) {
+bool logger_set_module_level(const char* module, const log_level_t level) {
+  if (!module || (unsigned)level >= LOG_LEVEL_NUM) {
     SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
     return false;
   }
 
-  g_param.fp = fp_init(fpath);
-  if (!g_param.fp) { return false; }
+  if (!mutex_lock(&g_module_mutex)) { return false; }
+  bool res = true;
+  size_t i = 0;
+  while (i < g_nmodule_level && strcmp(g_module_levels[i].name, module) != 0) {
+    i++;
+  }
+  if (i == g_nmodule_level) {
+    log_module_level_t* new_levels = (log_module_level_t*)realloc(
+        g_module_levels, (g_nmodule_level + 1) * sizeof(*new_levels)
+    );
+    if (new_levels) {
+      g_module_levels = new_levels;
+    } else {
+      SET_ERR_LOG_AUTO(ERR_MEM_ALLOC_FAILED);
+    }
+    char* name = new_levels ? my_strdup(module) : NULL;
+    if (!name) {
+      res = false;
+    } else {
+      g_module_levels[g_nmodule_level++].name = name;
+    }
+  }
+  if (res) {
+    g_module_levels[i].level = level;
+    update_filter_gen();
+  }
+  if (!mutex_unlock(&g_module_mutex)) { return false; }
 
-  if (!fp_setvbuf(g_param.fp, STREAM_BUF_SIZE)) { return false; }
+  return res;
+}
 
-  return true;
+/**
+ * @brief モジュールごとのログレベルをすべて解除する。
+ */
+void logger_clear_module_levels(void) {
+  if (!mutex_lock(&g_module_mutex)) { return; }
+  for (size_t i = 0; i < g_nmodule_level; i++) {
+    free(g_module_levels[i].name);
+  }
+  if (g_module_levels) { free(g_module_levels); }
+  g_module_levels = NULL;
+  if (g_nmodule_level > 0) { update_filter_gen(); }
+  g_nmodule_level = 0;
+  mutex_unlock(&g_module_mutex);
 }
 
 /**
- * @brief 非同期モードを設定する。
- * @param async 非同期モードフラグ。
- * @param nqueue 非同期モード用のキューの数。
+ * @brief iniファイルの[logger]セクションからログレベルを読み込む。
+ *
+ * - level: デフォルトのインスタンスのログレベル
+ * - その他のキー: モジュールごとのログレベル（キーはモジュール名または
+ *   ファイル名）
+ *
+ * 例:
+ *   [logger]
+ *   level = INFO
+ *   net = DEBUG
+ *   db.c = WARN
+ *
+ * - 不正なログレベルは読み飛ばし、失敗として返す。
+ * @param ini Iniデータ。
  * @return 成功: true, 失敗: false。
  */
-static bool logger_set_async(const bool async) {
-  g_param.async = async;
-  if (!g_param.async) { return true; }
-
-  g_param.queue = queue_init(MAX_QUEUE_NO);
-  if (!g_param.queue) { return false; }
-
-  g_param.worker_running = true;
-  if (pthread_mutex_init(&g_param.mutex, NULL) != 0) {
-    SET_ERR_LOG_AUTO(ERR_MUTEX_INIT_FAILED);
+bool logger_load_levels(Ini* ini) {
+  if (!ini) {
+    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
     return false;
   }
-  if (pthread_cond_init(&g_param.cond, NULL) != 0) {
-    SET_ERR_LOG_AUTO(ERR_CONDITION_INIT_FAILED);
-    return false;
+
+  bool res = true;
+  log_level_t level;
+  const char* value = ini_get(ini, "logger", "level", NULL);
+  if (value) {
+    if (parse_level(value, &level)) {
+      logger_set_level(level);
+    } else {
+      SET_ERR_LOG(ERR_INVALID_ARG, "Invalid log level. [level=%s]", value);
+      res = false;
+    }
   }
-  if (pthread_create(&g_param.worker, NULL, worker, NULL) != 0) {
-    g_param.worker_running = false;
-    SET_ERR_LOG_AUTO(ERR_THREAD_CREATE_FAILED);
-    return false;
+
+  for (IniSection* sec = ini->sections; sec; sec = sec->next) {
+    if (!sec->name || strcmp(sec->name, "logger") != 0) { continue; }
+    for (IniKV* kv = sec->kv; kv; kv = kv->next) {
+      if (!kv->key || strcmp(kv->key, "level") == 0) { continue; }
+      value = kv->value;
+      if (!parse_level(value, &level)) {
+        SET_ERR_LOG(
+            ERR_INVALID_ARG, "Invalid log level. [%s=%s]", kv->key,
+            value ? value : ""
+        );
+        res = false;
+        continue;
+      }
+      if (!logger_set_module_level(kv->key, level)) { res = false; }
+    }
   }
 
-  return true;
+  return res;
 }
 
-// ----------------------------------------------------------------------------
-// 以降、公開関数
-// ----------------------------------------------------------------------------
+/**
+ * @brief 呼び出し箇所のフィルタ状態を解決してキャッシュする。
+ *
+ * - logger_site_enabledが世代の変更を検出した場合のみ呼び出す。
+ * @param site 呼び出し箇所データ。
+ * @return フィルタ状態。（世代 | log_filter_t）
+ */
+unsigned logger_resolve_site(log_site_t* site) {
+  if (!site) { return LOG_FILTER_FOLLOW; }
+
+  site = site_register(site);
+  if (!mutex_lock(&g_module_mutex)) { return LOG_FILTER_FOLLOW; }
+  unsigned filter =
+      atomic_load_explicit(&g_log_filter_gen, memory_order_relaxed);
+  log_level_t level;
+  if (!find_module_level(site, &level)) {
+    filter |= LOG_FILTER_FOLLOW;
+  } else {
+    filter |= site->level >= level ? LOG_FILTER_ON : LOG_FILTER_OFF;
+  }
+  atomic_store_explicit(&site->filter, filter, memory_order_relaxed);
+  mutex_unlock(&g_module_mutex);
+
+  return filter;
+}
 
 /**
- * @brief ログ処理を初期化する。
- * @param out ログ出力フラグ。
- * @param level ログレベル。
- * @param fmt ログフォーマット。
- * @param async 非同期モードフラグ。
- * @param fpath ログファイルパス。（NULLの場合、stderr）
- * @return 成功: true, 失敗: false。
+ * @brief 出力制限: N回に1回だけ出力する。
+ *
+ * - 1回目を出力し、以降はN回ごとに出力する。
+ * @param self 出力制限の状態。
+ * @param n 出力間隔[回]。（0, 1: 毎回）
+ * @return 出力: true, 抑制: false。
  */
-bool logger_init(
-    const log_out_t out, const log_level_t level, const char* fmt,
-    const bool async, const char* fpath
-) {
-  // ログ出力フラグを設定
-  logger_set_out(out);
-  // ログレベルを設定
-  logger_set_level(level);
-  // ログフォーマットを設定
-  if (!logger_set_format(fmt)) { return false; }
-  // ログストリームを設定
-  if (!logger_set_stream(fpath)) { return false; }
-  // 非同期モードを設定
-  if (!logger_set_async(async)) { return false; }
+bool logger_limit_every_n(log_limit_t* self, const uint64_t n) {
+  uint64_t count =
+      atomic_fetch_add_explicit(&self->count, 1, memory_order_relaxed);
+  if (n <= 1 || count % n == 0) { return true; }
 
-  return true;
+  atomic_fetch_add_explicit(&self->suppressed, 1, memory_order_relaxed);
+  return false;
 }
 
 /**
- * @brief ログ処理を終了する。
+ * @brief 出力制限: 最初のN回だけ出力する。
+ *
+ * - 以降に抑制したログの数は、次の出力がないため通知しない。
+ * @param self 出力制限の状態。
+ * @param n 出力する回数。
+ * @return 出力: true, 抑制: false。
  */
-void logger_close(void) {
-  if (g_param.async) {
-    // スレッドを停止
-    if (!mutex_lock(&g_param.mutex)) { return; }
-    g_param.worker_running = false;
-    if (!cond_signal(&g_param.cond)) { return; }
-    if (!mutex_unlock(&g_param.mutex)) { return; }
-    pthread_join(g_param.worker, NULL);
+bool logger_limit_first_n(log_limit_t* self, const uint64_t n) {
+  uint64_t count =
+      atomic_fetch_add_explicit(&self->count, 1, memory_order_relaxed);
+  if (count < n) { return true; }
+
+  atomic_fetch_add_explicit(&self->suppressed, 1, memory_order_relaxed);
+  return false;
+}
 
-    queue_destroy(&g_param.queue);
-    pthread_mutex_destroy(&g_param.mutex);
-    pthread_cond_destroy(&g_param.cond);
+/**
+ * @brief 出力制限: 指定時間に1回だけ出力する。
+ *
+ * - 前回の出力から指定時間以上経過した最初の呼び出しのみ出力する。
+ *   （複数のスレッドが同時に到達しても、1つのスレッドのみ出力する）
+ * @param self 出力制限の状態。
+ * @param ms 出力間隔[ms]。
+ * @return 出力: true, 抑制: false。
+ */
+bool logger_limit_every_ms(log_limit_t* self, const uint64_t ms) {
+  uint64_t now = get_monotonic_ns();
+  uint64_t next = atomic_load_explicit(&self->next_ns, memory_order_relaxed);
+  if (now >= next && atomic_compare_exchange_strong_explicit(
+                         &self->next_ns, &next, now + ms * 1000000,
+                         memory_order_relaxed, memory_order_relaxed
+                     )) {
+    return true;
   }
-  fp_destroy(&g_param.fp);
-  format_destroy(&g_param.format);
+
+  atomic_fetch_add_explicit(&self->suppressed, 1, memory_order_relaxed);
+  return false;
 }
 
 /**
- * @brief ログを出力する。
+ * @brief 出力制限: トークンバケットで出力頻度を制限する。
  *
- * - 通常は本関数をラップしたマクロを使用する。
+ * - 1秒あたりper_sec個のトークンを補充し、最大burst個まで連続で出力する。
+ * - トークン数の代わりに理論上の次の到着時刻(GCRA)を1つのアトミック変数で
+ *   管理し、ロックを使用しない。
+ * @param self 出力制限の状態。
+ * @param per_sec 1秒あたりの出力数。（0: 出力しない）
+ * @param burst 連続で出力できる最大数。（0: 1とする）
+ * @return 出力: true, 抑制: false。
+ */
+bool logger_limit_rate(
+    log_limit_t* self, const uint64_t per_sec, const uint64_t burst
+) {
+  if (per_sec > 0) {
+    uint64_t interval = 1000000000u / per_sec;
+    uint64_t tolerance = interval * (burst > 1 ? burst - 1 : 0);
+    uint64_t now = get_monotonic_ns();
+    uint64_t tat = atomic_load_explicit(&self->next_ns, memory_order_relaxed);
+    while (true) {
+      uint64_t base = tat > now ? tat : now;
+      if (base - now > tolerance) { break; }
+      if (atomic_compare_exchange_weak_explicit(
+              &self->next_ns, &tat, base + interval, memory_order_relaxed,
+              memory_order_relaxed
+          )) {
+        return true;
+      }
+    }
+  }
+
+  atomic_fetch_add_explicit(&self->suppressed, 1, memory_order_relaxed);
+  return false;
+}
+
+/**
+ * @brief 出力制限を通過したログを出力する。
  *
- * @param level ログレベル。
- * @param fpath ファイルパス。
- * @param func 関数名。
- * @param line 行番号。
+ * - 通常は本関数をラップしたLOG_EVERY_N等のマクロを使用する。
+ * - 前回の出力以降に抑制したログの数をメッセージの末尾に付ける。
+ * @param self ログ処理のインスタンス。
+ * @param site 呼び出し箇所データ。
+ * @param limit 出力制限の状態。
  * @param fmt 可変長メッセージ。
  */
-void logger_log(
-    const log_level_t level, const char* fpath, const char* func,
-    const int line, const char* fmt, ...
+void logger_log_limited(
+    logger_t* self, log_site_t* site, log_limit_t* limit, const char* fmt, ...
 ) {
-  if (!fmt) { return; }
-  if (level < g_param.level) { return; }
+  if (!self || !site || !limit || !fmt) { return; }
 
+  size_t suppressed =
+      atomic_exchange_explicit(&limit->suppressed, 0, memory_order_relaxed);
   va_list ap;
   va_start(ap, fmt);
+  logger_vlog(self, site, suppressed, fmt, ap);
+  va_end(ap);
+}
 
-  // 必要サイズの取得
-  va_list ap_copy;
-  va_copy(ap_copy, ap);
-  int needed = vsnprintf(NULL, 0, fmt, ap_copy);
-  va_end(ap_copy);
-  if (needed < 0) {
-    va_end(ap);
-    return;
-  }
+/**
+ * @brief 構造化ログを出力する。
+ *
+ * - LOG_*_KVマクロから呼び出す。
+ * - 呼び出し箇所のメッセージはフォーマットせず、フィールドとともに
+ *   ログデータにコピーする。（遅延フォーマットは使用しない）
+ * - テキスト形式では「メッセージ key=value ...」、JSON Lines形式では
+ *   フィールドをJSONオブジェクトのメンバとして出力する。
+ * @param self ログ処理のインスタンス。
+ * @param site 呼び出し箇所データ。
+ * @param fields フィールドの配列。（キーは文字列リテラルであること）
+ * @param nfield フィールドの数。
+ */
+void logger_log_kv(
+    logger_t* self, log_site_t* site, const log_field_t* fields,
+    const size_t nfield
+) {
+  if (!self || !site) { return; }
+  if (!logger_site_enabled(self, site, site->level)) { return; }
 
-  // フォーマット部分のメモリ確保
-  char* msg = malloc((size_t)needed + 1);
-  if (!msg) {
-    va_end(ap);
-    return;
-  }
+  site = site_register(site);
 
-  if (vsnprintf(msg, (size_t)needed + 1, fmt, ap) < 0) {
-    free(msg);
-    va_end(ap);
-    return;
-  }
-  va_end(ap);
+  log_item_t local;
+  log_item_t* item = logger_begin_item(self, site, &local);
+  if (!item) { return; }
 
-  // ファイルパスからファイル名を取得
-  char* fname = get_fname(fpath);
-
-  // 同期モード（直接フォーマットして書き出し）
-  if (!g_param.async) {
-    log_item_t item = {
-        .level = level,
-        .fname = fname,
-        .func = (char*)func,
-        .line = line,
-        .msg = msg,
-    };
-    output_line(&item);
-    free(msg);
-    return;
+  const char* msg = site->fmt ? site->fmt : "";
+  logger_end_item(self, item, item_set_kv(item, msg, fields, nfield));
+}
+
+/**
+ * @brief 致命的なシグナルで出力待ちのログを書き込むハンドラを設定する。
+ *
+ * - SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRTを受けた場合、開始中の
+ *   全インスタンスの未フラッシュのデータ、フライトレコーダのログ、
+ *   キューに残ったログをwrite(2)で直接書き込み、ファイルをfsyncしてから、
+ *   設定前の動作でシグナルを再送する。
+ * - ハンドラは非同期シグナル安全な関数のみ使用する。ログ出力の処理には
+ *   何も追加しないため、設定しない場合の性能に影響しない。
+ * - キューに残ったログの時刻は、呼び出し時に取得した値をUNIX時刻で
+ *   書き込む。（localtime_rは非同期シグナル安全ではないため）
+ *   遅延フォーマットのログは、フォーマット文字列をそのまま書き込む。
+ * - 複数回呼び出した場合、2回目以降は何もしない。
+ * @return 成功: true, 失敗: false。
+ */
+bool logger_install_crash_handler(void) {
+  if (atomic_exchange(&g_crash_installed, true)) { return true; }
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = crash_handler;
+  sigemptyset(&action.sa_mask);
+  for (size_t i = 0; i < LOG_CRASH_SIGNAL_NUM; i++) {
+    if (sigaction(CRASH_SIGNALS[i], &action, &g_crash_actions[i]) != 0) {
+      // 設定済みのシグナルを元に戻す
+      for (size_t j = 0; j < i; j++) {
+        sigaction(CRASH_SIGNALS[j], &g_crash_actions[j], NULL);
+      }
+      atomic_store(&g_crash_installed, false);
+      SET_ERR_LOG_AUTO(ERR_UNKNOWN);
+      return false;
+    }
   }
 
-  // 非同期モード（項目を確保してキューに追加）
-  log_item_t* item = log_item_init();
-  if (!item) {
-    free(msg);
-    return;
+  return true;
+}
+
+/**
+ * @brief フライトレコーダのログを書き込む。
+ *
+ * - フライトレコーダを使用する全シンクについて、保持しているログと
+ *   キューに格納済みのログを書き込み、書き込むまで待機する。
+ * @return 成功: true, 失敗: false。
+ */
+bool logger_dump_recorder(void) { return logger_dump_recorder_to(&g_logger); }
+
+/**
+ * @brief 指定したインスタンスのフライトレコーダのログを書き込む。
+ * @param self ログ処理のインスタンス。
+ * @return 成功: true, 失敗: false。
+ */
+bool logger_dump_recorder_to(logger_t* self) {
+  if (!self) {
+    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
+    return false;
   }
-  item->level = level;
-  item->fname = fname ? my_strdup(fname) : my_strdup("");
-  item->func = func ? my_strdup(func) : my_strdup("");
-  item->line = line;
-  item->msg = msg;
 
-  if (!mutex_lock(&g_param.mutex)) { return; }
-  if (enqueue_item(item)) {
-    if (!cond_signal(&g_param.cond)) { return; }
-  } else {
-    log_item_destroy(&item);
+  // 書き込み要求を設定し、フラッシュで書き込む
+  for (size_t i = 0; i < self->nsink; i++) {
+    if (self->sinks[i].recorder.cap > 0) {
+      atomic_store_explicit(&self->sinks[i].dump, true, memory_order_relaxed);
+    }
   }
-  if (!mutex_unlock(&g_param.mutex)) { return; }
+
+  return logger_flush_to(self);
 }
@@ -6,101 +6,651 @@
 
 #pragma once
 
+// clock_gettime, localtime_rを使用するため
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+// syscall(SYS_gettid)を使用するため
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
 #include <pthread.h>
+#include <signal.h>
 #include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <threads.h>
+#include <time.h>
+#include <unistd.h>
+
+// 単調増加時刻にTSCを使用できるアーキテクチャ
+#if defined(__x86_64__) || defined(__i386__)
+#define LOG_HAS_TSC 1
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
 
+#include "argfmt.h"
+#include "logbin.h"
 #include "logger.h"
+#include "ring.h"
+#include "rotator.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// [ユーザが設定変更可能] ログデータのメッセージのインラインバイト数
+#ifndef LOG_ITEM_MSG_LEN
+#define LOG_ITEM_MSG_LEN 256
+#endif
+
 // ログデータ
-typedef struct {
-  log_level_t level;
-  char* fname;
-  char* func;
-  int line;
-  char* msg;
+//
+// - 遅延フォーマットの場合、bufまたはovfには引数の生のバイト列を格納し、
+//   書き込むスレッドがそれぞれのメッセージバッファにフォーマットする。
+// - 構造化ログの場合、bufまたはovfにはメッセージの終端文字に続けて
+//   フィールドを格納する。（log_field_t + 文字列の場合は本体と終端文字）
+// - 専用スレッドのシンクには参照で渡すため、キューから取り出した後は
+//   参照数以外を変更しない。
+typedef struct log_item_t {
+  const log_site_t* site;      // 呼び出し箇所データ
+  char* msg;                   // メッセージ（bufまたはovfを指す）
+  char* ovf;                   // インライン領域に収まらないデータ用
+  bool deferred;               // 遅延フォーマットフラグ
+  size_t len;                  // 遅延フォーマット: 引数のバイト数
+  size_t kv_len;               // 構造化ログ: フィールドのバイト数
+  struct timespec ts;          // 時刻（呼び出し元で取得、全シンクで共通）
+  uint64_t mono_ns;            // 単調増加時刻[ns]（%M）
+  uint64_t seq;                // 全インスタンス共通の通し番号（%N）
+  pid_t tid;                   // 呼び出し元のスレッドID（%t）
+  pid_t pid;                   // 呼び出し元のプロセスID（%P）
+  atomic_int refs;             // 参照数（ワーカー + 専用スレッドのシンク）
+  struct log_lane_t* lane;     // 返却先のキュー（同期モードではNULL）
+  char buf[LOG_ITEM_MSG_LEN];  // メッセージのインライン領域
 } log_item_t;
 
-// パラメータ
+// 非同期モードのキュー
+//
+// - ログデータを事前確保し、未使用のものをプール、出力待ちのものをキューで
+//   管理する。
+typedef struct log_lane_t {
+  size_t nitem;           // ログデータの数
+  log_item_t* items;      // 事前確保したログデータ配列
+  ring_t* pool;           // 未使用のログデータ
+  ring_t* queue;          // 出力待ちのログデータ（ロックフリー）
+  pthread_mutex_t mutex;  // プールの空き待ち用mutex
+  pthread_cond_t cond;    // プールの空き待ち用cond（返却時に通知）
+  bool cond_ready;        // mutex, condの初期化済みフラグ
+  atomic_int waiters;     // プールの空きを待っているスレッドの数
+} log_lane_t;
+
+// ログレベルの数
+#define LOG_LEVEL_NUM (LOG_LEVEL_ERROR + 1)
+
+// 出力待ちデータのバッファ
+typedef struct {
+  char* data;  // データ
+  size_t len;  // データのバイト数
+  size_t cap;  // 使用可能なメモリサイズ
+} log_buf_t;
+
+// スレッドごとの作業バッファ
+//
+// - 行をまたいで再利用し、スレッド終了時に解放する。
+typedef struct {
+  log_buf_t line;        // 同期モード: 直接書き込む1行分のバッファ
+  log_buf_t scratch;     // 同期モード: メッセージのフォーマット用バッファ
+  bool registered;       // 解放の登録済みフラグ
+  pid_t tid;             // スレッドIDのキャッシュ（0: 未取得）
+  pid_t pid;             // プロセスIDのキャッシュ
+  uint64_t tsc_base;     // TSC: 基準時刻のTSC値（0: 未取得）
+  uint64_t tsc_base_ns;  // TSC: 基準時刻[ns]
+  uint64_t mono_last;    // TSC: 最後に返した単調増加時刻[ns]
+} log_tls_t;
+
+// 呼び出し箇所データの登録状態
+typedef enum {
+  LOG_SITE_NEW = 0,  // 未登録
+  LOG_SITE_BUSY,     // 登録中
+  LOG_SITE_READY,    // 登録済み
+} log_site_state_t;
+
+// モジュールごとのログレベル
+typedef struct {
+  char* name;         // モジュール名またはファイル名（拡張子は省略可）
+  log_level_t level;  // ログレベル
+} log_module_level_t;
+
+// ログフォーマットの命令種別
+typedef enum {
+  LOG_FORMAT_OP_LITERAL = 0,  // リテラル
+  LOG_FORMAT_OP_TIME,         // %T : タイムスタンプ
+  LOG_FORMAT_OP_MSEC,         // %e : ミリ秒
+  LOG_FORMAT_OP_USEC,         // %u : マイクロ秒
+  LOG_FORMAT_OP_LEVEL,        // %l : ログレベル
+  LOG_FORMAT_OP_FNAME,        // %F : ファイル名
+  LOG_FORMAT_OP_LINE,         // %L : 行番号
+  LOG_FORMAT_OP_FUNC,         // %f : 関数名
+  LOG_FORMAT_OP_MSG,          // %m : メッセージ
+  LOG_FORMAT_OP_TID,          // %t : スレッドID
+  LOG_FORMAT_OP_PID,          // %P : プロセスID
+  LOG_FORMAT_OP_SEQ,          // %N : 通し番号
+  LOG_FORMAT_OP_MONO,         // %M : 単調増加時刻[ns]
+} log_format_op_type_t;
+
+// 呼び出し元で取得する値（ログフォーマットで使用する場合のみ）
+typedef enum {
+  LOG_STAMP_THREAD = 1u << 0,  // スレッドID、プロセスID
+  LOG_STAMP_SEQ = 1u << 1,     // 通し番号
+  LOG_STAMP_MONO = 1u << 2,    // 単調増加時刻
+} log_stamp_t;
+
+// ログフォーマットの命令
+typedef struct {
+  log_format_op_type_t type;  // 命令種別
+  const char* str;            // リテラル: 文字列（strの一部を指す）
+  size_t len;                 // リテラル: バイト数
+} log_format_op_t;
+
+// コンパイル済みログフォーマット
+typedef struct {
+  char* str;             // ログフォーマット
+  log_format_op_t* ops;  // 命令配列
+  size_t nop;            // 命令数
+  bool use_time;         // 時刻を使用する命令の有無
+  unsigned stamp;        // 呼び出し元で取得する値（log_stamp_tの論理和）
+} log_format_t;
+
+// TSCの較正結果
+typedef struct {
+  bool valid;             // 使用可能フラグ（不変TSCで較正済み）
+  double ns_per_tick;     // 1カウントあたりの時間[ns]
+  uint64_t anchor_ticks;  // 基準時刻を取り直すカウント数
+} log_tsc_t;
+
+// タイムスタンプ（秒まで）の最大バイト数
+#define LOG_TIME_STR_SIZE 32
+
+// タイムスタンプのキャッシュ
+//
+// - 秒が変わった場合のみ再作成し、秒未満は時刻から直接書き込む。
 typedef struct {
-  log_out_t out;          // ログ出力フラグ
-  log_level_t level;      // ログレベル
-  char* format;           // ログフォーマットのポインタ
-  FILE* fp;               // ログ出力用のファイルポインタ
+  time_t sec;                   // キャッシュした時刻[s]
+  char str[LOG_TIME_STR_SIZE];  // タイムスタンプ（秒まで）
+  size_t len;                   // タイムスタンプのバイト数
+} log_time_cache_t;
+
+// フライトレコーダ
+//
+// - フォーマット済みの直近のログを保持するリングバッファ。満杯の場合、
+//   古いログから行単位で上書きする。
+typedef struct {
+  char* data;   // データ
+  size_t cap;   // 容量（0: 無効）
+  size_t head;  // 最も古い行の先頭位置
+  size_t len;   // データのバイト数
+} log_recorder_t;
+
+// シンク（出力先）
+//
+// - 専用スレッドを使用しないシンクには、ワーカー（同期モードでは呼び出し元）
+//   が書き込む。
+// - 専用スレッドを使用するシンクには、ワーカーがログデータを参照で渡す。
+//   （キューが満杯の場合、そのシンクでのみ破棄し、他のシンクを待たせない）
+typedef struct {
+  logger_t* logger;          // シンクを所有するログ処理
+  log_sink_type_t type;      // シンクの種類
+  log_level_t level;         // ログレベル
+  log_format_t* format;      // コンパイル済みログフォーマット
+  FILE* fp;                  // ファイル: ファイルポインタ（fdに直接書き込む）
+  rotator_t* rotator;        // ファイル: ローテーションする場合のファイル
+  bool binary;               // ファイル: バイナリ形式フラグ
+  bool json;                 // JSON Lines形式フラグ
+  uint64_t bin_last_ns;      // バイナリ形式: 直前のレコードの時刻[ns]
+  uint64_t bin_flushed_ns;   // バイナリ形式: 書き込み済みの最後の時刻[ns]
+  unsigned char* bin_sites;  // バイナリ形式: 呼び出し箇所の書き込み済みフラグ
+  size_t bin_nsites;         // バイナリ形式: 書き込み済みフラグの数
+  log_buf_t buf;             // 出力待ちデータ（未フラッシュ）
+  log_recorder_t recorder;   // フライトレコーダ（容量0: 無効）
+  atomic_bool dump;          // フライトレコーダ: 書き込み要求フラグ
+  atomic_int fd;             // 書き込み先のfd（クラッシュ時, -1: なし）
+  uint64_t flushed_ns;       // 最後にフラッシュした時刻[ns]（単調増加）
+  size_t reported[LOG_LEVEL_NUM];  // 通知済みの破棄したログの数
+  atomic_size_t dropped[LOG_LEVEL_NUM];  // キューが満杯で破棄したログの数
+  bool direct;                // 同期モード: 1行ずつ直接書き込むフラグ
+  bool thread;                // 専用スレッドの使用フラグ
+  ring_t* queue;              // 専用スレッド: 出力待ちのログデータ
+  pthread_t worker;           // 専用スレッド: スレッドID
+  pthread_mutex_t mutex;      // 専用スレッド: 待機用mutex
+  pthread_cond_t cond;        // 専用スレッド: 待機用cond
+  bool worker_running;        // 専用スレッド: 実行フラグ
+  atomic_bool sleeping;       // 専用スレッド: 待機中フラグ
+  atomic_bool crash_parked;   // 専用スレッド: クラッシュ時の停止済みフラグ
+  atomic_uint_least64_t flush_req;  // 専用スレッド: logger_flushの要求番号
+  uint64_t flush_done;  // 専用スレッド: 完了したlogger_flushの要求番号
+  char* msg;            // 専用スレッド: メッセージバッファ
+  size_t msg_cap;       // 専用スレッド: メッセージバッファサイズ
+} log_sink_t;
+
+// クラッシュ時の書き込みバッファのバイト数
+#define LOG_CRASH_BUF_SIZE 4096
+
+// クラッシュ時の書き込みバッファ
+//
+// - シグナルハンドラのスタック上に作成し、メモリを確保せずに書き込む。
+typedef struct {
+  int fd;                         // 書き込み先のfd
+  size_t len;                     // データのバイト数
+  char last;                      // 最後に書き込んだ文字
+  char data[LOG_CRASH_BUF_SIZE];  // データ
+} log_crash_buf_t;
+
+// ログ処理のインスタンス
+//
+// - インスタンスごとにキュー、ワーカー、シンクを持ち、互いに影響しない。
+// - LOG_*マクロはデフォルトのインスタンス（g_logger）に出力する。
+// - 先頭はログ出力用マクロがインラインで参照する公開部分とする。
+struct logger_t {
+  logger_head_t head;     // 公開部分（実行時のログレベル）
+  log_level_t min_level;  // 全シンクのログレベルの最小値
+  log_sink_t* sinks;      // シンクの配列
+  size_t nsink;           // シンクの数
   bool async;             // 非同期モードフラグ
-  pthread_mutex_t mutex;  // 非同期モード: 排他制御用mutex
-  pthread_cond_t cond;    // 非同期モード: 排他制御用cond
+  bool deferred;          // 遅延フォーマットフラグ
+  pthread_mutex_t mutex;  // 非同期モード: ワーカー待機用mutex
+  pthread_cond_t cond;    // 非同期モード: ワーカー待機用cond
   pthread_t worker;       // 非同期モード: スレッドID
   bool worker_running;    // 非同期モード: 実行フラグ
-  size_t nqueue;          // 非同期モード: キューに格納するログデータの最大数
-  log_item_t** queue;     // 非同期モード: キュー
-  size_t q_head;          // 非同期モード: キューの先頭番号
-  size_t q_tail;          // 非同期モード: キューの末尾番号
-  size_t q_count;         // 非同期モード: キューに格納されているログデータの数
-} log_param_t;
+  atomic_bool sleeping;   // 非同期モード: ワーカー待機中フラグ
+  atomic_bool crash_parked;  // 非同期モード: クラッシュ時の停止済みフラグ
+  atomic_bool batching;      // 非同期モード: ワーカーのログ蓄積待ち中フラグ
+  uint64_t batch_ns;  // 非同期モード: ログ蓄積待ちの最大時間[ns]（0: 無効）
+  size_t batch_num;   // 非同期モード: ログ蓄積待ちを終えるログの数
+  log_lane_t lane;        // 非同期モード: キュー
+  log_lane_t err_lane;    // 非同期モード: ERROR専用キュー
+  bool priority;          // 非同期モード: ERROR専用キューの使用フラグ
+  log_overflow_t overflow;  // 非同期モード: キューが満杯の場合の動作
+  unsigned block_ms;        // 非同期モード: 満杯時の待機時間[ms]
+  atomic_size_t dropped[LOG_LEVEL_NUM];  // 破棄したログの数（レベルごと）
+  size_t flush_bytes;        // フラッシュする未フラッシュのバイト数
+  uint64_t flush_ns;         // フラッシュ間隔[ns]（0: 無効）
+  log_level_t flush_level;   // 即時フラッシュするログレベル（以上）
+  pthread_cond_t flush_cond;  // logger_flush: 完了待ち用cond
+  atomic_bool flush_pending;  // logger_flush: 要求中フラグ
+  uint64_t flush_req;         // logger_flush: 要求番号
+  uint64_t flush_done;        // logger_flush: 完了した要求番号
+  size_t flush_pos;           // logger_flush: 要求時のキューの格納位置
+  size_t flush_err_pos;  // logger_flush: 要求時のERROR専用キューの格納位置
+  pthread_mutex_t out_mutex;  // 同期モード: 出力用mutex
+  bool direct;  // 同期モード: 直接書き込むシンクの有無（mutexを取らない）
+  unsigned stamp;  // 呼び出し元で取得する値（全シンクの論理和）
+  bool tsc;        // 単調増加時刻にTSCを使用するフラグ
+  char* msg;              // 遅延フォーマット: ワーカーのメッセージバッファ
+  size_t msg_cap;  // 遅延フォーマット: ワーカーのメッセージバッファサイズ
+  uint64_t coalesce_ns;  // 重複行: まとめる最大時間[ns]（0: 無効）
+  const log_site_t* last_site;  // 重複行: 直前に出力したログの呼び出し箇所
+  bool last_deferred;   // 重複行: 直前に出力したログの遅延フォーマットフラグ
+  log_buf_t last_data;  // 重複行: 直前に出力したログのメッセージまたは引数
+  log_item_t* repeat;   // 重複行: 出力を保留した最初の重複ログ
+  size_t nrepeat;       // 重複行: 保留中の重複ログの数
+  uint64_t repeat_ns;   // 重複行: 最初の重複ログを保留した時刻[ns]
+};
 
 // デフォルトフォーマット
 static const char* DEFAULT_FORMAT = "[%T][%l][%F:%L][%f()] - %m";
-// ログストリームのバッファリングサイズ
+// ファイルの出力待ちデータをフラッシュするバイト数（デフォルト）
 static const size_t STREAM_BUF_SIZE = 16 * 1024;
-// キューの最大数
+// ワーカーが一度に取り出すログデータの最大数
+#define WORKER_BATCH_NUM 256
+// ワーカーが待機する前にキューを確認する回数（スピン）
+static const unsigned WORKER_SPIN_NUM = 64;
+// キューの最大数（デフォルト）
 static const size_t MAX_QUEUE_NO = 4 * 1024;
+// 専用スレッドのシンクのキューの最大数（デフォルト）
+static const size_t MAX_SINK_QUEUE_NO = 1024;
+// ERROR専用キューの最大数
+static const size_t MAX_ERR_QUEUE_NO = 256;
+// 破棄したログの数を出力する間隔[行]（キューが空になった場合も出力する）
+static const size_t DROPPED_REPORT_INTERVAL = 1024;
+// キューの空き待ちで、ワーカーを起こし直す間隔[ns]（通知の取りこぼし対策）
+static const uint64_t BLOCK_WAKE_NS = 10 * 1000 * 1000;
+// キューの空き待ちの最大時間[ms]（block_msが0の場合）
+static const unsigned DEFAULT_BLOCK_MS = 1000;
 // ログの変換指定子1つ分の最大バッファサイズ
 static const size_t MAX_CONV_SPEC_SIZE = 256;
+// ミリ秒の桁数
+static const size_t MSEC_DIGITS = 3;
+// マイクロ秒の桁数
+static const size_t USEC_DIGITS = 6;
+// ナノ秒の桁数
+static const size_t NSEC_DIGITS = 9;
+// ログレベルの表示幅（空白で埋める）
+static const size_t LEVEL_WIDTH = 5;
+// TSCを較正する時間[ns]
+static const long TSC_CALIBRATE_NS = 10 * 1000 * 1000;
+// TSCから求める時刻の基準を取り直す間隔[ns]（較正の誤差の蓄積を抑える）
+static const double TSC_ANCHOR_NS = 1000 * 1000;
 // 作成するログ1行分の最小バッファサイズ
 static const size_t MIN_LOG_SIZE = 1024;
+// 可変長整数(varint)の最大バイト数
+#define BIN_VARINT_MAX 10
+// 呼び出し箇所の書き込み済みフラグの初期数
+static const size_t INI_BIN_SITE_NUM = 64;
 
-// パラメータの初期化
-static log_param_t g_param = {
-    .out = LOG_BOTH_OUT,
-    .level = LOG_LEVEL_INFO,
-    .format = NULL,
-    .fp = NULL,
+// デフォルトのインスタンスの初期化（logger.hでextern宣言）
+logger_t g_logger = {
+    .head = {.level = LOG_LEVEL_INFO},
+    .min_level = LOG_LEVEL_DEBUG,
+    .sinks = NULL,
+    .nsink = 0,
     .async = true,
+    .deferred = false,
     .mutex = {{0}},
     .cond = {{{0}}},
     .worker = 0,
     .worker_running = false,
-    .nqueue = 1024,
-    .queue = NULL,
-    .q_head = 0,
-    .q_tail = 0,
-    .q_count = 0,
+    .sleeping = false,
+    .crash_parked = false,
+    .batching = false,
+    .batch_ns = 0,
+    .batch_num = WORKER_BATCH_NUM,
+    .lane = {0},
+    .err_lane = {0},
+    .priority = false,
+    .overflow = LOG_OVERFLOW_DROP_OLDEST,
+    .block_ms = 0,
+    .dropped = {0},
+    .flush_bytes = 0,
+    .flush_ns = 0,
+    .flush_level = LOG_LEVEL_ERROR,
+    .flush_cond = {{{0}}},
+    .flush_pending = false,
+    .flush_req = 0,
+    .flush_done = 0,
+    .flush_pos = 0,
+    .flush_err_pos = 0,
+    .out_mutex = PTHREAD_MUTEX_INITIALIZER,
+    .direct = false,
+    .msg = NULL,
+    .msg_cap = 0,
+    .coalesce_ns = 0,
+    .last_site = NULL,
+    .last_deferred = false,
+    .last_data = {0},
+    .repeat = NULL,
+    .nrepeat = 0,
+    .repeat_ns = 0,
+};
+
+// クラッシュ時に出力待ちデータを書き込むインスタンスの最大数
+#define LOG_CRASH_LOGGER_NUM 16
+// クラッシュ時にワーカーの停止を待つ最大時間[ms]
+static const unsigned CRASH_WAIT_MS = 100;
+// クラッシュ時に出力待ちデータを書き込むシグナルの数
+#define LOG_CRASH_SIGNAL_NUM 5
+// クラッシュ時に出力待ちデータを書き込むシグナル
+static const int CRASH_SIGNALS[LOG_CRASH_SIGNAL_NUM] = {
+    SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT,
 };
 
-static log_item_t* log_item_init(void);
-static void log_item_destroy(log_item_t** item);
-static char* format_init(const char* fmt);
-static void format_destroy(char** self);
+// タイムスタンプのキャッシュ（スレッドごと）
+static thread_local log_time_cache_t g_time_cache = {.sec = -1};
+// 作業バッファ（スレッドごと）
+static thread_local log_tls_t g_tls = {0};
+// 作業バッファをスレッド終了時に解放するためのキー
+static pthread_key_t g_tls_key;
+// 作業バッファのキーの作成用
+static pthread_once_t g_tls_once = PTHREAD_ONCE_INIT;
+// 全インスタンス共通の通し番号（最後に採番したもの）
+static atomic_uint_least64_t g_seq = 0;
+// TSCの較正結果
+static log_tsc_t g_tsc = {0};
+// TSCの較正用
+static pthread_once_t g_tsc_once = PTHREAD_ONCE_INIT;
+
+// 登録済み呼び出し箇所リストの先頭
+static _Atomic(log_site_t*) g_sites = NULL;
+// 登録済み呼び出し箇所の数
+static atomic_uint g_nsites = 0;
+
+// クラッシュ時に出力待ちデータを書き込むインスタンス（開始中のもの）
+static _Atomic(logger_t*) g_crash_loggers[LOG_CRASH_LOGGER_NUM];
+// シグナルハンドラの設定済みフラグ
+static atomic_bool g_crash_installed = false;
+// シグナルハンドラの実行中フラグ（多重実行の防止）
+static atomic_bool g_crash_active = false;
+// 設定前のシグナルの動作（再送前に戻す）
+static struct sigaction g_crash_actions[LOG_CRASH_SIGNAL_NUM];
+
+// モジュールごとのログレベルの世代（logger.hでextern宣言）
+atomic_uint g_log_filter_gen = 0;
+// モジュールごとのログレベルの配列
+static log_module_level_t* g_module_levels = NULL;
+// モジュールごとのログレベルの数
+static size_t g_nmodule_level = 0;
+// モジュールごとのログレベルの排他制御用mutex
+static pthread_mutex_t g_module_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static log_item_t* items_init(const size_t nitem);
+static void items_destroy(log_item_t** self, const size_t nitem);
+static ring_t* pool_init(log_item_t* items, const size_t nitem);
+static void item_clear(log_item_t* self);
+static char* item_reserve(log_item_t* self, const size_t size);
+static int item_format(
+    const log_item_t* self, const char* fmt, char* out, const size_t cap,
+    va_list ap
+);
+static bool item_set_msg(log_item_t* self, const char* fmt, va_list ap);
+static bool item_append_suppressed(log_item_t* self, const size_t suppressed);
+static bool item_append_repeated(
+    log_item_t* self, const size_t nrepeat, char** pmsg, size_t* pmsg_cap
+);
+static bool item_set_args(log_item_t* self, va_list ap);
+static size_t get_fields_size(const log_field_t* fields, const size_t nfield);
+static bool item_set_kv(
+    log_item_t* self, const char* msg, const log_field_t* fields,
+    const size_t nfield
+);
+static const char* item_get_fields(const log_item_t* self);
+static const char* field_decode(const char* data, log_field_t* field);
+static const char* item_get_data(const log_item_t* self, size_t* size);
+static const char* item_render(
+    const log_item_t* self, char** pout, size_t* pcap
+);
+static log_item_t* item_acquire(logger_t* logger, const log_level_t level);
+static log_item_t* item_wait(
+    logger_t* logger, log_lane_t* lane, const unsigned timeout_ms
+);
+static void item_release(log_item_t* item);
+static void item_unref(log_item_t* item);
+static log_format_t* format_init(const char* fmt);
+static void format_destroy(log_format_t** self);
+static log_format_op_type_t get_format_op_type(const char ch);
+static unsigned get_format_stamp(const log_format_op_type_t type);
 static FILE* fp_init(const char* fpath);
 static void fp_destroy(FILE** self);
-static bool fp_setvbuf(FILE* self, const size_t bufsize);
-static log_item_t** queue_init(const size_t nqueue);
-static void queue_destroy(log_item_t*** self);
+static ring_t* queue_init(const size_t nqueue);
+static void queue_destroy(ring_t** self);
+static bool lane_init(log_lane_t* self, const size_t nitem);
+static void lane_destroy(log_lane_t* self);
+static log_lane_t* get_lane(logger_t* logger, const log_level_t level);
+static void count_dropped(logger_t* logger, const log_level_t level);
 static bool mutex_lock(pthread_mutex_t* mutex);
 static bool mutex_unlock(pthread_mutex_t* mutex);
 static bool cond_signal(pthread_cond_t* cond);
 static bool cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex);
+static bool cond_timedwait(
+    pthread_cond_t* cond, pthread_mutex_t* mutex, const uint64_t timeout_ns,
+    bool* timeout
+);
+static log_site_t* site_register(log_site_t* site);
+static int get_module_rank(const log_site_t* site, const char* name);
+static bool find_module_level(const log_site_t* site, log_level_t* level);
+static void update_filter_gen(void);
+static bool parse_level(const char* str, log_level_t* level);
 static char* get_level_name(const log_level_t level);
 static bool realloc_format_line(
     char** pout, size_t* cap, const size_t needed_size
 );
-static char* format_line(const log_item_t* item);
-static bool output_line(const log_item_t* item);
-static bool enqueue_item(log_item_t* item);
-static log_item_t* dequeue_item(void);
+static bool buf_reserve(log_buf_t* self, const size_t size);
+static bool buf_append(log_buf_t* self, const void* data, const size_t size);
+static void buf_destroy(log_buf_t* self);
+static void tls_key_init(void);
+static void tls_destroy(void* arg);
+static void tls_atfork_child(void);
+static log_tls_t* get_tls(void);
+static bool write_fd(const int fd, const char* data, const size_t size);
+static bool recorder_init(log_recorder_t* self, const size_t cap);
+static void recorder_destroy(log_recorder_t* self);
+static size_t recorder_find_line(const log_recorder_t* self, size_t pos);
+static void recorder_append(
+    log_recorder_t* self, const char* data, const size_t size
+);
+static bool recorder_take(log_recorder_t* self, log_buf_t* out);
+static const log_time_cache_t* get_time_cache(const time_t sec);
+static bool format_line(
+    const log_format_t* format, const log_item_t* item, const char* msg,
+    log_buf_t* out
+);
+static bool write_field_value(
+    log_buf_t* out, const log_field_t* field, const bool json
+);
+static bool write_fields(log_buf_t* out, const log_item_t* item);
+static uint64_t json_needs_escape(const uint64_t chunk);
+static bool json_write_str(log_buf_t* out, const char* str, const size_t len);
+static bool json_write_site(log_buf_t* out, const log_site_t* site);
+static char* json_build_site(const log_site_t* site);
+static bool output_json(
+    log_buf_t* out, const log_item_t* item, const char* msg
+);
+static uint64_t get_realtime_ns(void);
+static uint64_t get_monotonic_ns(void);
+static void tsc_calibrate(void);
+static uint64_t get_tsc_ns(void);
+static pid_t get_thread_id(void);
+static size_t bin_encode_varint(unsigned char* out, uint64_t value);
+static bool bin_write_str(log_buf_t* out, const char* str);
+static bool bin_write_header(log_buf_t* out, const uint64_t base_ns);
+static bool bin_write_site(
+    log_sink_t* sink, log_buf_t* out, const log_site_t* site
+);
+static bool bin_write_sites(log_sink_t* sink, log_buf_t* out);
+static bool output_binary(log_sink_t* sink, const log_item_t* item);
+static bool sink_init(log_sink_t* self, const logger_sink_config_t* config);
+static void sink_destroy(log_sink_t* self);
+static bool sink_write(
+    log_sink_t* self, const log_item_t* item, const char* msg
+);
+static bool write_rotator(log_sink_t* self);
+static void sink_flush(log_sink_t* self);
+static void sink_flush_by_policy(log_sink_t* self, const log_level_t level);
+static void sink_flush_by_interval(log_sink_t* self);
+static uint64_t get_flush_wait_ns(const log_sink_t* self);
+static void sink_output_dropped(log_sink_t* self);
+static void sink_enqueue(log_sink_t* self, log_item_t* item);
+static void sink_output_items(
+    log_sink_t* self, log_item_t** items, const size_t nitem
+);
+static void sink_complete_flush(log_sink_t* self);
+static bool wake_sink(log_sink_t* self);
+static bool park_sink(log_sink_t* self);
+static void* sink_worker(void* arg);
+static bool sink_start(log_sink_t* self);
+static void sink_stop(log_sink_t* self);
+static void flush_sinks(logger_t* logger);
+static void flush_sinks_by_policy(logger_t* logger, const log_level_t level);
+static bool flush_completed(const logger_t* logger, const uint64_t req);
+static void complete_flush_request(logger_t* logger);
+static void output_line(
+    logger_t* logger, log_item_t* item, char** pmsg, size_t* pmsg_cap
+);
+static void output_direct(logger_t* logger, log_item_t* item);
+static void output_items(
+    logger_t* logger, log_item_t** items, const size_t nitem
+);
+static bool item_is_repeat(const logger_t* logger, const log_item_t* item);
+static bool coalesce_item(logger_t* logger, log_item_t* item);
+static void output_repeat(logger_t* logger);
+static void flush_repeat(logger_t* logger, const bool force);
+static void enqueue_item(logger_t* logger, log_item_t* item);
+static log_item_t* dequeue_item(logger_t* logger);
+static bool queue_is_empty(const logger_t* logger);
+static size_t queue_size(const logger_t* logger);
+static void output_dropped(logger_t* logger);
+static bool wake_worker(logger_t* logger, const bool urgent);
+static bool spin_worker(const logger_t* logger);
+static bool park_worker(logger_t* logger);
+static void batch_worker(logger_t* logger);
 static void* worker(void* arg);
-static void logger_set_out(const log_out_t out);
-static void logger_set_level(const log_level_t level);
-static bool logger_set_format(const char* fmt);
-static bool logger_set_stream(const char* fpath);
-static bool logger_set_async(const bool async);
+static bool logger_set_sinks(logger_t* self, const logger_config_t* config);
+static void logger_set_deferred(logger_t* self, const bool deferred);
+static void logger_set_flush(
+    logger_t* self, const size_t bytes, const unsigned interval_ms,
+    const log_level_t level
+);
+static void logger_set_coalesce(logger_t* self, const unsigned coalesce_ms);
+static void logger_set_batch(
+    logger_t* self, const unsigned batch_us, const size_t nqueue
+);
+static void logger_set_tsc(logger_t* self, const bool tsc);
+static void logger_set_overflow(
+    logger_t* self, const log_overflow_t overflow, const unsigned block_ms,
+    const bool priority
+);
+static bool logger_set_async(
+    logger_t* self, const bool async, const size_t nqueue
+);
+static bool logger_start(logger_t* self, const logger_config_t* config);
+static void logger_stop(logger_t* self);
+static void item_stamp(const logger_t* logger, log_item_t* item);
+static log_item_t* logger_begin_item(
+    logger_t* self, const log_site_t* site, log_item_t* local
+);
+static void logger_end_item(logger_t* self, log_item_t* item, const bool res);
+static void logger_vlog(
+    logger_t* self, log_site_t* site, const size_t suppressed, const char* fmt,
+    va_list ap
+);
+static void crash_park(atomic_bool* parked);
+static void crash_wait_parked(
+    const bool running, const atomic_bool* parked, const atomic_bool* sleeping,
+    const atomic_bool* batching
+);
+static void crash_register(logger_t* logger);
+static void crash_unregister(logger_t* logger);
+static void crash_write_fd(const int fd, const char* data, const size_t size);
+static void crash_flush(log_crash_buf_t* self);
+static void crash_write(log_crash_buf_t* self, const char* data, size_t size);
+static void crash_write_str(log_crash_buf_t* self, const char* str);
+static void crash_write_uint(log_crash_buf_t* self, unsigned long long value);
+static void crash_write_int(log_crash_buf_t* self, const long long value);
+static void crash_write_double(log_crash_buf_t* self, const double value);
+static void crash_write_json(log_crash_buf_t* self, const char* str);
+static void crash_write_field_value(
+    log_crash_buf_t* self, const log_field_t* field, const bool json
+);
+static void crash_write_line(
+    log_crash_buf_t* self, const log_format_t* format, const log_item_t* item
+);
+static void crash_write_json_line(
+    log_crash_buf_t* self, const log_item_t* item
+);
+static void crash_write_item(
+    const log_sink_t* sink, const int fd, const log_item_t* item
+);
+static void crash_dump_logger(logger_t* logger);
+static void crash_handler(int sig);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,28 @@
+/**
+ * ロックフリーリングバッファ用公開ヘッダ。
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// リングバッファ
+typedef struct ring_t ring_t;
+
+ring_t* ring_init(const size_t nslot);
+void ring_destroy(ring_t** self);
+bool ring_push(ring_t* self, void* data);
+void* ring_pop(ring_t* self);
+bool ring_is_empty(ring_t* self);
+size_t ring_capacity(const ring_t* self);
+size_t ring_head(ring_t* self);
+size_t ring_tail(ring_t* self);
+
+#ifdef __cplusplus
+}
+#endif
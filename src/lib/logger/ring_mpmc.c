@@ -0,0 +1,205 @@
+/**
+ * ロックフリーリングバッファ処理関数群。
+ *
+ * - 格納・取り出しともにCASで位置を確保するため、複数スレッドから同時に
+ *   呼び出してよい。（生産者が古いデータを破棄するために取り出す場合がある）
+ */
+
+#include "ring_mpmc.h"
+
+#include "error/error.h"
+
+/**
+ * @brief 2のべき乗に切り上げる。
+ * @param n 値。
+ * @return n以上の最小の2のべき乗。
+ */
+static size_t round_up_pow2(size_t n) {
+  size_t pow2 = 1;
+  while (pow2 < n) { pow2 <<= 1; }
+  return pow2;
+}
+
+// ----------------------------------------------------------------------------
+// 以降、公開関数
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief リングバッファのメモリを確保する。
+ *
+ * - スロット数は2のべき乗に切り上げる。
+ * @param nslot スロット数。
+ * @return リングバッファ。
+ */
+ring_t* ring_init(const size_t nslot) {
+  if (nslot < 1) {
+    SET_ERR_LOG(
+        ERR_INVALID_ARG, "The number of slots must be set to 1 or more. [%zu]",
+        nslot
+    );
+    return NULL;
+  }
+
+  ring_t* self = aligned_alloc(CACHE_LINE_SIZE, sizeof(*self));
+  if (!self) {
+    SET_ERR_LOG_AUTO(ERR_MEM_ALLOC_FAILED);
+    return NULL;
+  }
+  memset(self, 0, sizeof(*self));
+
+  size_t cap = round_up_pow2(nslot);
+  self->slots = calloc(cap, sizeof(*self->slots));
+  if (!self->slots) {
+    SET_ERR_LOG_AUTO(ERR_MEM_ALLOC_FAILED);
+    free(self);
+    return NULL;
+  }
+
+  for (size_t i = 0; i < cap; i++) {
+    atomic_init(&self->slots[i].seq, i);
+  }
+  atomic_init(&self->head, 0);
+  atomic_init(&self->tail, 0);
+  self->mask = cap - 1;
+
+  return self;
+}
+
+/**
+ * @brief リングバッファのメモリを解放する。
+ *
+ * - 格納されているデータは解放しない。
+ * @param self リングバッファ。
+ */
+void ring_destroy(ring_t** self) {
+  if (!self || !*self) { return; }
+
+  if ((*self)->slots) { free((*self)->slots); }
+  free(*self);
+  *self = NULL;
+}
+
+/**
+ * @brief リングバッファの末尾にデータを格納する。
+ * @param self リングバッファ。
+ * @param data データ。（NULL不可）
+ * @return 成功: true, 空きがない: false。
+ */
+bool ring_push(ring_t* self, void* data) {
+  if (!self || !data) { return false; }
+
+  size_t pos = atomic_load_explicit(&self->tail, memory_order_relaxed);
+  while (true) {
+    ring_slot_t* slot = &self->slots[pos & self->mask];
+    size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+    if (diff == 0) {
+      // スロットが空いている場合、格納位置を確保して書き込み
+      if (atomic_compare_exchange_weak_explicit(
+              &self->tail, &pos, pos + 1, memory_order_relaxed,
+              memory_order_relaxed
+          )) {
+        slot->data = data;
+        atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+        return true;
+      }
+    } else if (diff < 0) {
+      // 1周前のデータが取り出されていない場合、満杯
+      return false;
+    } else {
+      // 他の生産者に先を越された場合、位置を読み直す
+      pos = atomic_load_explicit(&self->tail, memory_order_relaxed);
+    }
+  }
+}
+
+/**
+ * @brief リングバッファの先頭からデータを取り出す。
+ * @param self リングバッファ。
+ * @return データ。（空の場合、NULL）
+ */
+void* ring_pop(ring_t* self) {
+  if (!self) { return NULL; }
+
+  size_t pos = atomic_load_explicit(&self->head, memory_order_relaxed);
+  while (true) {
+    ring_slot_t* slot = &self->slots[pos & self->mask];
+    size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+    if (diff == 0) {
+      // データが書き込み済みの場合、取り出し位置を確保して読み出し
+      if (atomic_compare_exchange_weak_explicit(
+              &self->head, &pos, pos + 1, memory_order_relaxed,
+              memory_order_relaxed
+          )) {
+        void* data = slot->data;
+        atomic_store_explicit(
+            &slot->seq, pos + self->mask + 1, memory_order_release
+        );
+        return data;
+      }
+    } else if (diff < 0) {
+      // 書き込み済みのデータがない場合、空
+      return NULL;
+    } else {
+      // 他の消費者に先を越された場合、位置を読み直す
+      pos = atomic_load_explicit(&self->head, memory_order_relaxed);
+    }
+  }
+}
+
+/**
+ * @brief リングバッファが空か判定する。
+ *
+ * - 書き込み途中のスロットは空として扱う。
+ * @param self リングバッファ。
+ * @return 空: true, データあり: false。
+ */
+bool ring_is_empty(ring_t* self) {
+  if (!self) { return true; }
+
+  size_t pos = atomic_load_explicit(&self->head, memory_order_acquire);
+  ring_slot_t* slot = &self->slots[pos & self->mask];
+  size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+
+  return seq != pos + 1;
+}
+
+/**
+ * @brief リングバッファのスロット数を取得する。
+ * @param self リングバッファ。
+ * @return スロット数。
+ */
+size_t ring_capacity(const ring_t* self) {
+  if (!self) { return 0; }
+
+  return self->mask + 1;
+}
+
+/**
+ * @brief リングバッファの取り出し位置を取得する。
+ *
+ * - 位置は取り出しごとに1ずつ増加する通し番号とする。
+ * @param self リングバッファ。
+ * @return 取り出し位置。
+ */
+size_t ring_head(ring_t* self) {
+  if (!self) { return 0; }
+
+  return atomic_load_explicit(&self->head, memory_order_acquire);
+}
+
+/**
+ * @brief リングバッファの格納位置を取得する。
+ *
+ * - 位置は格納ごとに1ずつ増加する通し番号とする。
+ * - 取り出し位置がこの値以上になれば、それまでに格納したデータはすべて
+ *   取り出し済みとなる。
+ * @param self リングバッファ。
+ * @return 格納位置。
+ */
+size_t ring_tail(ring_t* self) {
+  if (!self) { return 0; }
+
+  return atomic_load_explicit(&self->tail, memory_order_acquire);
+}
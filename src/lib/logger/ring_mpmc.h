@@ -0,0 +1,42 @@
+/**
+ * ロックフリーリングバッファ用ヘッダ。
+ *
+ * - シーケンス番号付きスロットによる有界キュー (Vyukov方式)
+ */
+
+#pragma once
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// キャッシュラインのバイトサイズ
+#define CACHE_LINE_SIZE 64
+
+// スロット
+typedef struct {
+  atomic_size_t seq;  // シーケンス番号
+  void* data;         // 格納データ
+} ring_slot_t;
+
+// リングバッファ
+struct ring_t {
+  alignas(CACHE_LINE_SIZE) atomic_size_t head;  // 取り出し位置
+  alignas(CACHE_LINE_SIZE) atomic_size_t tail;  // 格納位置
+  alignas(CACHE_LINE_SIZE) size_t mask;         // スロット番号のマスク
+  ring_slot_t* slots;                           // スロット配列
+};
+
+static size_t round_up_pow2(size_t n);
+
+#ifdef __cplusplus
+}
+#endif
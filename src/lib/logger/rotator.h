@@ -1,4 +1,3 @@
-
 /**
  * ファイルローテーション用公開ヘッダ。
  */
@@ -6,11 +5,29 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ファイルローテーションのインスタンス（rotator_file.h参照）
+typedef struct rotator_t rotator_t;
 
-bool rotator_init(
+rotator_t* rotator_init(
     const char* dpath, const char* fname, const char* extension,
     size_t max_fsize, size_t max_fno
 );
-void rotator_close(void);
-bool rotator_rotate(size_t len);
-bool rotator_fputs(const char* line);
\ No newline at end of file
+rotator_t* rotator_init_fpath(
+    const char* fpath, size_t max_fsize, size_t max_fno
+);
+void rotator_close(rotator_t** self);
+bool rotator_is_full(const rotator_t* self, size_t len);
+bool rotator_rotate(rotator_t* self, size_t len);
+bool rotator_fputs(rotator_t* self, const char* line);
+bool rotator_write(rotator_t* self, const void* data, size_t len);
+int rotator_fileno(const rotator_t* self);
+
+#ifdef __cplusplus
+}
+#endif
@@ -8,7 +8,7 @@
 #include "utils.h"
 
 /**
- * @brief ファイルを開く。
+ * @brief ファイルをバッファなしで開く。
  * @param fpath ファイルパス。
  * @return ファイルストリーム。
  */
@@ -23,6 +23,8 @@ static FILE* fp_init(const char* fpath) {
     SET_ERR_LOG_AUTO(ERR_FILE_OPEN_FAILED);
     return NULL;
   }
+  // 書き込みごとに1回のwriteで出力する
+  setvbuf(self, NULL, _IONBF, 0);
 
   return self;
 }
@@ -248,7 +250,10 @@ static bool sort_file_list_desc(file_list_t* flist) {
 
 /**
  * @brief ファイルパスの末尾に現在の日時を付与する。
- * @param new_fpath 新規ファイルパス。
+ *
+ * - 同じ秒に複数回ローテーションした場合、既存のアーカイブを上書きしないよう
+ *   末尾に連番を付与する。
+ * @param new_fpath 新規ファイルパス。（FPATH_SIZEバイト以上）
  * @param fpath 元のファイルパス。
  * @return 成功: true, 失敗: false。
  */
@@ -259,11 +264,21 @@ static bool make_fpath(char* new_fpath, const char* fpath) {
   }
 
   struct tm tm = get_current_time();
-  snprintf(
-      new_fpath, FPATH_SIZE * sizeof(new_fpath), "%s.%04d%02d%02d-%02d%02d%02d",
-      fpath, tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour,
-      tm.tm_min, tm.tm_sec
+  int len = snprintf(
+      new_fpath, FPATH_SIZE, "%s.%04d%02d%02d-%02d%02d%02d", fpath,
+      tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min,
+      tm.tm_sec
   );
+  if (len < 0 || len >= FPATH_SIZE) {
+    SET_ERR_LOG_AUTO(ERR_MEM_OUT_OF_RANGE);
+    return false;
+  }
+
+  struct stat st;
+  for (unsigned no = 1; stat(new_fpath, &st) == 0; no++) {
+    size_t pos = (size_t)len;
+    snprintf(new_fpath + pos, FPATH_SIZE - pos, ".%u", no);
+  }
 
   return true;
 }
@@ -364,74 +379,147 @@ static bool get_all_file_info(
   return true;
 }
 
+/**
+ * @brief 最新ファイルを閉じてアーカイブし、次の書き込みファイルを開く。
+ * @param self ファイルローテーションのインスタンス。
+ * @return 成功: true, 失敗: false。
+ */
+static bool rotate_file(rotator_t* self) {
+  char new_fpath[FPATH_SIZE];
+
+  file_list_t* flist = self->flist;
+
+  // 最新ファイルを閉じてリネーム
+  fp_destroy(&self->fp);
+  if (!make_fpath(new_fpath, flist->finfos[0]->fpath)) { return false; }
+  rename(flist->finfos[0]->fpath, new_fpath);
+
+  // ファイル情報データを更新
+  file_info_t* info = get_file_info(new_fpath);
+  if (!info) { return false; }
+
+  if (!finfo_update(&flist->finfos[0], info)) { return false; }
+
+  finfo_destroy(&info);
+  sort_file_list_desc(flist);
+
+  // アーカイブファイル数の確認
+  if (flist->cur_fno + 1 > flist->max_fno) {
+    if (flist->max_fno != 1) {
+      remove(flist->finfos[flist->cur_fno - 1]->fpath);
+    }
+    if (!flist_del_last_finfo(flist)) { return false; }
+  }
+
+  // 次の書き込みファイルをオープンしてファイル情報リストを更新
+  self->fp = fp_init(self->base_fpath);
+  if (!self->fp) { return false; }
+
+  info = get_file_info(self->base_fpath);
+  if (!info) { return false; }
+
+  info->mtime += 1;  // ソート対応
+  if (flist_add_finfo(flist, info) != 0) {
+    finfo_destroy(&info);
+    return false;
+  }
+  finfo_destroy(&info);
+  sort_file_list_desc(flist);
+
+  return true;
+}
+
 /**
  * @brief 最大ファイルサイズを設定する。
+ * @param self ファイルローテーションのインスタンス。
  * @param size ファイルの最大サイズ。
  */
-static void rotator_set_max_fsize(size_t size) { g_param.max_fsize = size; }
+static void rotator_set_max_fsize(rotator_t* self, size_t size) {
+  self->max_fsize = size;
+}
 
 /**
  * @brief 最大ファイルアーカイブ数を設定する。
  *
  * - ファイルのアーカイブ数 + 1（書き込み対象）を設定する。
+ * @param self ファイルローテーションのインスタンス。
  * @param no ファイルの最大アーカイブ数。
  */
-static void rotator_set_max_fno(size_t no) { g_param.max_fno = no + 1; }
+static void rotator_set_max_fno(rotator_t* self, size_t no) {
+  self->max_fno = no + 1;
+}
 
 /**
  * @brief ベースのファイルパスを設定する。
+ * @param self ファイルローテーションのインスタンス。
  * @param dpath ディレクトリパス。
  * @param fname ファイル名。（拡張子含まないこと）
  * @param extension 拡張子。（ドットを含むこと）
  * @return 成功: true, 失敗: false。
  */
 static bool rotator_set_base_fpath(
-    const char* dpath, const char* fname, const char* extension
+    rotator_t* self, const char* dpath, const char* fname,
+    const char* extension
 ) {
   if (!dpath || !fname || !extension) {
     SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
     return false;
   }
+  if (strlen(dpath) + strlen(fname) + strlen(extension) + 2 > FPATH_SIZE) {
+    SET_ERR_LOG_AUTO(ERR_MEM_OUT_OF_RANGE);
+    return false;
+  }
 
   char tmp_fpath[FPATH_SIZE] = {0};
   if (!joinstr(tmp_fpath, dpath, "/", fname)) { return false; }
-  if (!joinstr(g_param.base_fpath, tmp_fpath, "", extension)) { return false; }
+  if (!joinstr(self->base_fpath, tmp_fpath, "", extension)) { return false; }
 
   return true;
 }
 
 /**
  * @brief アーカイブ数 + 1の最新ファイル情報をリストに設定する。
+ *
+ * - ベースのファイルパスで始まるファイル（書き込みファイルとそのアーカイブ）
+ *   のみを対象とする。
+ * @param self ファイルローテーションのインスタンス。
  * @param dpath ディレクトリパス。
- * @param extension 拡張子。
  * @return 成功: true, 失敗: false。
  */
-static bool rotator_set_file_info(const char* dpath, const char* extension) {
+static bool rotator_set_file_info(rotator_t* self, const char* dpath) {
   // 全ファイル情報の取得
   file_list_t* all_flist = flist_init(INI_FILE_NUM);
   if (!all_flist) { return false; }
 
-  if (!get_all_file_info(all_flist, dpath, extension)) { return false; }
+  if (!get_all_file_info(all_flist, dpath, self->base_fpath)) {
+    flist_destroy(&all_flist);
+    return false;
+  }
 
   // 最大でアーカイブ数 + 1（書き込み対象）の最新ファイル情報を取得
-  file_list_t* flist = flist_init(g_param.max_fno);
-  if (!flist) { return false; }
+  file_list_t* flist = flist_init(self->max_fno);
+  if (!flist) {
+    flist_destroy(&all_flist);
+    return false;
+  }
 
   size_t loop_num = MIN(all_flist->cur_fno, flist->max_fno);
   for (size_t i = 0; i < loop_num; i++) {
     if (flist_add_finfo(flist, all_flist->finfos[i]) != 0) {
       flist_destroy(&all_flist);
+      flist_destroy(&flist);
       return false;
     }
   }
   flist_destroy(&all_flist);
+  self->flist = flist;
 
   // 書き込み（最新）ファイルのオープン
   if (flist->cur_fno == 0) {
-    g_param.fp = fp_init(g_param.base_fpath);
-    if (!g_param.fp) { return false; }
+    self->fp = fp_init(self->base_fpath);
+    if (!self->fp) { return false; }
 
-    file_info_t* info = get_file_info(g_param.base_fpath);
+    file_info_t* info = get_file_info(self->base_fpath);
     if (!info) { return false; }
 
     if (flist_add_finfo(flist, info) != 0) {
@@ -441,12 +529,10 @@ static bool rotator_set_file_info(const char* dpath, const char* extension) {
 
     finfo_destroy(&info);
   } else {
-    g_param.fp = fp_init(flist->finfos[0]->fpath);
-    if (!g_param.fp) { return false; }
+    self->fp = fp_init(flist->finfos[0]->fpath);
+    if (!self->fp) { return false; }
   }
 
-  g_param.flist = flist;
-
   return true;
 }
 
@@ -459,102 +545,195 @@ static bool rotator_set_file_info(const char* dpath, const char* extension) {
  * @param dpath ディレクトリパス。
  * @param fname ファイル名。（拡張子を含まないこと）
  * @param extension 拡張子。（ドットを含むこと）
- * @param max_fsize 最大ファイルバイトサイズ。
+ * @param max_fsize 最大ファイルバイトサイズ。（0: ローテーションしない）
  * @param max_fno 最大ファイルアーカイブ数。
- * @return 成功: true, 失敗: false。
+ * @return ファイルローテーションのインスタンス。（失敗: NULL）
  */
-bool rotator_init(
+rotator_t* rotator_init(
     const char* dpath, const char* fname, const char* extension,
     size_t max_fsize, size_t max_fno
 ) {
+  rotator_t* self = calloc(1, sizeof(*self));
+  if (!self) {
+    SET_ERR_LOG_AUTO(ERR_MEM_ALLOC_FAILED);
+    return NULL;
+  }
+
   // 最大ファイルバイトサイズの設定
-  rotator_set_max_fsize(max_fsize);
+  rotator_set_max_fsize(self, max_fsize);
   // 最大ファイルアーカイブ数の設定
-  rotator_set_max_fno(max_fno);
+  rotator_set_max_fno(self, max_fno);
   // ベースファイルパスの設定
-  if (!rotator_set_base_fpath(dpath, fname, extension)) { return false; }
+  if (!rotator_set_base_fpath(self, dpath, fname, extension)) {
+    rotator_close(&self);
+    return NULL;
+  }
   // ファイル情報リストの設定
-  if (!rotator_set_file_info(dpath, extension)) { return false; }
+  if (!rotator_set_file_info(self, dpath)) {
+    rotator_close(&self);
+    return NULL;
+  }
 
-  return true;
+  return self;
 }
 
 /**
- * @brief ローテーション処理を終了する。
+ * @brief ファイルパスからローテーション処理を初期化する。
+ *
+ * - ファイルパスをディレクトリパス、ファイル名、拡張子に分割して
+ *   rotator_initを呼び出す。（ディレクトリがない場合はカレントディレクトリ）
+ * @param fpath ファイルパス。
+ * @param max_fsize 最大ファイルバイトサイズ。（0: ローテーションしない）
+ * @param max_fno 最大ファイルアーカイブ数。
+ * @return ファイルローテーションのインスタンス。（失敗: NULL）
  */
-void rotator_close(void) {
-  fp_destroy(&g_param.fp);
-  flist_destroy(&g_param.flist);
+rotator_t* rotator_init_fpath(
+    const char* fpath, size_t max_fsize, size_t max_fno
+) {
+  if (!fpath) {
+    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
+    return NULL;
+  }
+  if (strlen(fpath) + 1 > FPATH_SIZE) {
+    SET_ERR_LOG_AUTO(ERR_MEM_OUT_OF_RANGE);
+    return NULL;
+  }
+
+  char dpath[FPATH_SIZE] = ".";
+  char fname[FPATH_SIZE];
+  char extension[FPATH_SIZE] = "";
+
+  const char* base = strrchr(fpath, '/');
+  if (base) {
+    size_t len = (size_t)(base - fpath);
+    if (len > 0) {
+      memcpy(dpath, fpath, len);
+      dpath[len] = '\0';
+    } else {
+      strcpy(dpath, "/");
+    }
+    base++;
+  } else {
+    base = fpath;
+  }
+
+  strcpy(fname, base);
+  char* dot = strrchr(fname, '.');
+  if (dot && dot != fname) {
+    strcpy(extension, dot);
+    *dot = '\0';
+  }
+
+  return rotator_init(dpath, fname, extension, max_fsize, max_fno);
 }
 
 /**
- * @brief ローテーション処理を実行する。
- * @param len ファイルへの書き込みバイトサイズ。
- * @return 成功: true, 失敗: false。
+ * @brief ローテーション処理を終了する。
+ * @param self ファイルローテーションのインスタンス。
  */
-bool rotator_rotate(size_t len) {
-  char new_fpath[FPATH_SIZE];
-
-  file_list_t* flist = g_param.flist;
-
-  // 書き込みサイズの確認
-  if (g_param.max_fsize != 0 &&
-      flist->finfos[0]->fsize + len > g_param.max_fsize) {
-    // 最新ファイルを閉じてリネーム
-    fp_destroy(&g_param.fp);
-    if (!make_fpath(new_fpath, flist->finfos[0]->fpath)) { return false; }
-    rename(flist->finfos[0]->fpath, new_fpath);
-
-    // ファイル情報データを更新
-    file_info_t* info = get_file_info(new_fpath);
-    if (!info) { return false; }
+void rotator_close(rotator_t** self) {
+  if (!self || !*self) { return; }
 
-    if (!finfo_update(&flist->finfos[0], info)) { return false; }
+  fp_destroy(&(*self)->fp);
+  flist_destroy(&(*self)->flist);
+  free(*self);
+  *self = NULL;
+}
 
-    finfo_destroy(&info);
-    sort_file_list_desc(flist);
+/**
+ * @brief 書き込むと最大ファイルサイズを超えるか確認する。
+ *
+ * - 空のファイルは、書き込みサイズに関わらず超えないものとする。
+ * @param self ファイルローテーションのインスタンス。
+ * @param len ファイルへの書き込みバイトサイズ。
+ * @return 超える: true, 超えない: false。
+ */
+bool rotator_is_full(const rotator_t* self, size_t len) {
+  if (!self || !self->flist || self->max_fsize == 0) { return false; }
 
-    // アーカイブファイル数の確認
-    if (flist->cur_fno + 1 > flist->max_fno) {
-      if (flist->max_fno != 1) {
-        remove(flist->finfos[flist->cur_fno - 1]->fpath);
-      }
-      if (!flist_del_last_finfo(flist)) { return false; }
-    }
+  size_t fsize = self->flist->finfos[0]->fsize;
 
-    // 次の書き込みファイルをオープンしてファイル情報リストを更新
-    g_param.fp = fp_init(g_param.base_fpath);
-    if (!g_param.fp) { return false; }
+  return fsize > 0 && fsize + len > self->max_fsize;
+}
 
-    info = get_file_info(g_param.base_fpath);
-    if (!info) { return false; }
+/**
+ * @brief ローテーション処理を実行する。
+ *
+ * - 書き込むと最大ファイルサイズを超える場合にローテーションし、
+ *   書き込みバイトサイズを最新ファイルのサイズに加算する。
+ * @param self ファイルローテーションのインスタンス。
+ * @param len ファイルへの書き込みバイトサイズ。
+ * @return 成功: true, 失敗: false。
+ */
+bool rotator_rotate(rotator_t* self, size_t len) {
+  if (!self || !self->flist) {
+    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
+    return false;
+  }
 
-    info->mtime += 1;  // ソート対応
-    if (flist_add_finfo(flist, info) != 0) {
-      finfo_destroy(&info);
-      return false;
-    }
-    finfo_destroy(&info);
-    sort_file_list_desc(flist);
+  // 書き込みサイズの確認
+  if (rotator_is_full(self, len)) {
+    if (!rotate_file(self)) { return false; }
   }
-  flist->finfos[0]->fsize += len;
+  self->flist->finfos[0]->fsize += len;
 
   return true;
 }
 
 /**
  * @brief 最新ファイルに書き込む。
+ * @param self ファイルローテーションのインスタンス。
  * @param line 書き込み文字列。
  * @return 成功: true, 失敗: false。
  */
-bool rotator_fputs(const char* line) {
-  if (!line) {
+bool rotator_fputs(rotator_t* self, const char* line) {
+  if (!self || !self->fp || !line) {
+    SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
+    return false;
+  }
+
+  fputs(line, self->fp);
+  fflush(self->fp);
+
+  return true;
+}
+
+/**
+ * @brief 必要に応じてローテーションしてから、最新ファイルに書き込む。
+ *
+ * - フォーマット済みのデータをまとめて渡すことで、ローテーションの判定と
+ *   書き込みを1回で行う。（データは分割せず、1つのファイルに書き込む）
+ * @param self ファイルローテーションのインスタンス。
+ * @param data 書き込むデータ。
+ * @param len 書き込むバイト数。
+ * @return 成功: true, 失敗: false。
+ */
+bool rotator_write(rotator_t* self, const void* data, size_t len) {
+  if (!self || (!data && len > 0)) {
     SET_ERR_LOG_AUTO(ERR_INVALID_ARG);
     return false;
   }
+  if (len == 0) { return true; }
 
-  fputs(line, g_param.fp);
-  fflush(g_param.fp);
+  if (!rotator_rotate(self, len)) { return false; }
+  if (!self->fp || fwrite(data, 1, len, self->fp) != len) {
+    SET_ERR_LOG_AUTO(ERR_IO_ERROR);
+    return false;
+  }
 
   return true;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief 最新ファイルのファイルディスクリプタを取得する。
+ *
+ * - ローテーションでファイルが切り替わると値が変わるため、書き込みの都度
+ *   取得し直すこと。
+ * @param self ファイルローテーションのインスタンス。
+ * @return 成功: ファイルディスクリプタ, 失敗: -1。
+ */
+int rotator_fileno(const rotator_t* self) {
+  if (!self || !self->fp) { return -1; }
+
+  return fileno(self->fp);
+}
@@ -4,9 +4,15 @@
 
 #pragma once
 
+// filenoを使用するため
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include <dirent.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <time.h>
 
@@ -31,22 +37,13 @@ typedef struct file_list_t {
   size_t max_fno;        // 最大ファイル数
 } file_list_t;
 
-// パラメータ
-typedef struct {
-  FILE* fp;                     // ファイルストリームのポインタ
+// ファイルローテーションのインスタンス
+struct rotator_t {
+  FILE* fp;                     // ファイルストリームのポインタ（バッファなし）
   size_t max_fsize;             // ログ出力ファイルの最大サイズ
   size_t max_fno;               // ログ出力ファイルの最大数
   file_list_t* flist;           // ファイル情報リストのポインタ
   char base_fpath[FPATH_SIZE];  // ベースのファイルパス
-} rot_param_t;
-
-// パラメータの初期化
-static rot_param_t g_param = {
-    .fp = NULL,
-    .max_fsize = 0,
-    .max_fno = 0,
-    .flist = NULL,
-    .base_fpath = {0},
 };
 
 static FILE* fp_init(const char* fpath);
@@ -66,9 +63,11 @@ static file_info_t* get_file_info(const char* fpath);
 static bool get_all_file_info(
     file_list_t* flist, const char* dpath, const char* search
 );
-static void rotator_set_max_fsize(size_t size);
-static void rotator_set_max_fno(size_t no);
+static bool rotate_file(rotator_t* self);
+static void rotator_set_max_fsize(rotator_t* self, size_t size);
+static void rotator_set_max_fno(rotator_t* self, size_t no);
 static bool rotator_set_base_fpath(
-    const char* dpath, const char* fname, const char* extension
+    rotator_t* self, const char* dpath, const char* fname,
+    const char* extension
 );
-static bool rotator_set_file_info(const char* dpath, const char* extension);
\ No newline at end of file
+static bool rotator_set_file_info(rotator_t* self, const char* dpath);